@@ -0,0 +1,113 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <json.hpp>
+using json = nlohmann::ordered_json;
+
+struct BenchResult
+{
+	std::string name;
+	int iterations = 0;
+	// median wall time of one iteration
+	double seconds = 0;
+	// work done by one iteration, 0 when it does not apply
+	double vertices = 0;
+	double bytes = 0;
+	unsigned threads = 1;
+	// peak resident set size the measured work added, 0 when not measured
+	uint64_t peakRssBytes = 0;
+
+	double verticesPerSecond() const { return seconds > 0 ? vertices / seconds : 0; }
+	double megabytesPerSecond() const { return seconds > 0 ? bytes / seconds / 1e6 : 0; }
+};
+
+// Runs benchmarks whose name contains the filter and collects their results.
+class BenchRunner
+{
+public:
+	BenchRunner(const std::string &filter, double minSeconds)
+		: mFilter(filter), mMinSeconds(minSeconds) {}
+
+	bool selected(const std::string &name) const
+	{
+		return mFilter.empty() || name.find(mFilter) != std::string::npos;
+	}
+
+	// Times `fn` until minSeconds have passed and at least three samples were
+	// taken. `fn` returns the number of bytes it produced.
+	template<class Fn>
+	void run(const std::string &name, double vertices, Fn fn, unsigned threads = 1)
+	{
+		if (!selected(name))
+			return;
+		std::vector<double> samples;
+		double bytes = 0;
+		double total = 0;
+		while (total < mMinSeconds || samples.size() < 3)
+		{
+			auto start = std::chrono::steady_clock::now();
+			bytes = double(fn());
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			samples.push_back(seconds);
+			total += seconds;
+		}
+		std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+
+		BenchResult result;
+		result.name = name;
+		result.iterations = int(samples.size());
+		result.seconds = samples[samples.size() / 2];
+		result.vertices = vertices;
+		result.bytes = bytes;
+		result.threads = threads;
+		add(result);
+	}
+
+	// for results measured by the caller
+	void add(const BenchResult &result)
+	{
+		printf("%-44s %8d %12.4f %12.2f %10.1f\n", result.name.c_str(), result.iterations, result.seconds * 1e3,
+			result.verticesPerSecond() / 1e6, result.megabytesPerSecond());
+		if (result.peakRssBytes)
+			printf("%-44s %12.1f MB peak RSS\n", result.name.c_str(), result.peakRssBytes / 1048576.0);
+		fflush(stdout);
+		mResults.push_back(result);
+	}
+
+	static void printHeader()
+	{
+		printf("%-44s %8s %12s %12s %10s\n", "benchmark", "iters", "ms/iter", "Mvertices/s", "MB/s");
+	}
+
+	json toJson() const
+	{
+		json j;
+		j["benchmarks"] = json::array();
+		for (const BenchResult &r : mResults)
+		{
+			j["benchmarks"].push_back({
+				{"name", r.name},
+				{"iterations", r.iterations},
+				{"secondsPerIteration", r.seconds},
+				{"threads", r.threads},
+				{"vertices", r.vertices},
+				{"bytes", r.bytes},
+				{"verticesPerSecond", r.verticesPerSecond()},
+				{"megabytesPerSecond", r.megabytesPerSecond()},
+				{"peakRssBytes", r.peakRssBytes},
+			});
+		}
+		return j;
+	}
+
+	const std::vector<BenchResult> &results() const { return mResults; }
+
+private:
+	std::string mFilter;
+	double mMinSeconds;
+	std::vector<BenchResult> mResults;
+};
@@ -0,0 +1,702 @@
+#include "./harness.h"
+#include "converter.h"
+#include "fbxb_reader.h"
+#include "fbxb_writer.h"
+#include "scene_generator.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cxxopts.hpp>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#ifndef FBX2JSON_BENCH_FBX
+#define FBX2JSON_BENCH_FBX "test/test.fbx"
+#endif
+
+// serializes with the streaming writer into memory, returns the bytes written
+template<class Fn>
+static size_t WriteToMemory(Fn fn)
+{
+    OutputStream out;
+    JsonTextWriter writer(out);
+    fn(writer);
+    return out.size();
+}
+
+// the whole hierarchy, instanced meshes counted once
+static double ControlPoints(FbxScene *pScene)
+{
+    double count = 0;
+    std::unordered_set<FbxMesh *> seen;
+    std::vector<FbxNode *> stack(1, pScene->GetRootNode());
+    while (!stack.empty())
+    {
+        FbxNode *node = stack.back();
+        stack.pop_back();
+        FbxMesh *pMesh = node->GetMesh();
+        if (pMesh && seen.insert(pMesh).second)
+            count += pMesh->GetControlPointsCount();
+        for (int i = 0; i < node->GetChildCount(); i++)
+            stack.push_back(node->GetChild(i));
+    }
+    return count;
+}
+
+// meshes of grid^2 control points with two UV channels, one color set and normals
+static GeneratorOptions BenchScene(int meshes, int grid)
+{
+    GeneratorOptions options;
+    options.meshes = meshes;
+    options.vertices = grid * grid;
+    options.uvSets = 2;
+    options.colorSets = 1;
+    return options;
+}
+
+static void RunMicroBenchmarks(BenchRunner &runner, FbxManager *pManager, int grid)
+{
+    FbxScene *pScene = FbxScene::Create(pManager, "micro");
+    FbxMesh *pMesh = SceneGenerator(BenchScene(1, grid)).generateMesh(pScene, "micro");
+    GeneratorOptions geometryOptions = BenchScene(1, grid);
+    geometryOptions.uvSets = 0;
+    geometryOptions.colorSets = 0;
+    geometryOptions.normals = false;
+    FbxMesh *pGeometry = SceneGenerator(geometryOptions).generateMesh(pScene, "geometry");
+    double controlPoints = pMesh->GetControlPointsCount();
+    double polygonVertices = pMesh->GetPolygonVertexCount();
+
+    runner.run("dumpIndexArray", polygonVertices, [&]() {
+        return WriteToMemory([&](SceneWriter &w) { Fbx2Json::dumpIndexArray(w, pMesh->GetElementUV(0)->GetIndexArray()); });
+    });
+    runner.run("dumpColorArray", controlPoints, [&]() {
+        return WriteToMemory([&](SceneWriter &w) { Fbx2Json::dumpColorArray(w, pMesh->GetElementVertexColor(0)->GetDirectArray()); });
+    });
+    runner.run("dumpVector2Array", controlPoints, [&]() {
+        return WriteToMemory([&](SceneWriter &w) { Fbx2Json::dumpVector2Array(w, pMesh->GetElementUV(0)->GetDirectArray()); });
+    });
+    runner.run("dumpVector4Array", polygonVertices, [&]() {
+        return WriteToMemory([&](SceneWriter &w) { Fbx2Json::dumpVector4Array(w, pMesh->GetElementNormal(0)->GetDirectArray()); });
+    });
+
+    // one color per polygon vertex, a lookup per vertex against one resolve
+    runner.run("vertexColors/getVertexColors", polygonVertices, [&]() {
+        std::vector<FbxColor> colors(pMesh->GetPolygonVertexCount());
+        const int *pVertices = pMesh->GetPolygonVertices();
+        for (int i = 0; i < pMesh->GetPolygonVertexCount(); i++)
+            Fbx2Json::getVertexColors(pMesh, pVertices[i], i, colors[i]);
+        return size_t(0);
+    });
+    runner.run("vertexColors/resolve", polygonVertices, [&]() {
+        std::vector<FbxColor> colors;
+        Fbx2Json::resolveVertexColors(pMesh, colors);
+        return size_t(0);
+    });
+
+    // control points and polygons only
+    ExportOptions nested;
+    ExportOptions csr;
+    csr.polygonLayout = ExportOptions::eCsrPolygons;
+    runner.run("polygons/nested", polygonVertices, [&]() {
+        return WriteToMemory([&](SceneWriter &w) { Fbx2Json::exportMesh(w, pGeometry, nested); });
+    });
+    runner.run("polygons/csr", polygonVertices, [&]() {
+        return WriteToMemory([&](SceneWriter &w) { Fbx2Json::exportMesh(w, pGeometry, csr); });
+    });
+
+    runner.run("exportMesh/stream", controlPoints, [&]() {
+        return WriteToMemory([&](SceneWriter &w) { Fbx2Json::exportMesh(w, pMesh); });
+    });
+    runner.run("exportMesh/dom", controlPoints, [&]() {
+        // builds the tree only, no bytes are produced
+        json j = Fbx2Json::exportMesh(pMesh);
+        return size_t(0);
+    });
+    json dom = Fbx2Json::exportMesh(pMesh);
+    runner.run("json::dump", controlPoints, [&]() {
+        return dom.dump(4).size();
+    });
+    pScene->Destroy();
+}
+
+static void RunGeneratedBenchmarks(BenchRunner &runner, FbxManager *pManager, int grid)
+{
+    // a few big meshes with the layers of a typical game asset
+    FbxScene *pScene = SceneGenerator(BenchScene(16, grid / 2)).generate(pManager);
+    double vertices = ControlPoints(pScene);
+    runner.run("generated/exportScene", vertices, [&]() {
+        return WriteToMemory([&](SceneWriter &w) { Fbx2Json::exportScene(w, pScene); });
+    });
+    runner.run("generated/exportScene+write", vertices, [&]() {
+        std::ofstream file("fbx2json_bench.json");
+        OutputStream out(&file);
+        JsonTextWriter writer(out);
+        Fbx2Json::exportScene(writer, pScene);
+        out.flush();
+        return out.tell();
+    });
+    std::remove("fbx2json_bench.json");
+    // adds the hashing pre-pass; the generated meshes only share their polygons
+    ExportOptions dedup;
+    dedup.dedupArrays = true;
+    runner.run("generated/exportScene/dedupArrays", vertices, [&]() {
+        return WriteToMemory([&](SceneWriter &w) { Fbx2Json::exportScene(w, pScene, dedup); });
+    });
+    pScene->Destroy();
+
+    // many smaller meshes, 1..N export threads
+    pScene = SceneGenerator(BenchScene(64, grid / 4)).generate(pManager);
+    vertices = ControlPoints(pScene);
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads = 1;; threads = std::min(cores, threads * 2))
+    {
+        ExportOptions options;
+        options.threads = threads;
+        runner.run("scaling/exportScene/threads=" + std::to_string(threads), vertices, [&]() {
+            return WriteToMemory([&](SceneWriter &w) { Fbx2Json::exportScene(w, pScene, options); });
+        }, threads);
+        if (threads == cores)
+            break;
+    }
+    pScene->Destroy();
+}
+
+// counts and drops everything written to it, so serializers can be timed
+// without the cost of growing a gigabyte of memory
+class CountingBuffer : public std::streambuf
+{
+public:
+    size_t count = 0;
+
+protected:
+    int overflow(int c) override
+    {
+        count++;
+        return c;
+    }
+    std::streamsize xsputn(const char *, std::streamsize n) override
+    {
+        count += size_t(n);
+        return n;
+    }
+};
+
+// the first `components` of every resolved element value against the fbxb
+// array of `semantic` and `set`; an element that cannot be resolved per
+// polygon vertex must have no array
+template<class T, class TValue>
+static bool SameFbxbElement(const FbxbReader &reader, const FbxbMesh &mesh, FbxbArray::Semantic semantic, int set, FbxMesh *pMesh,
+    const FbxLayerElementTemplate<TValue> *pElement, int components)
+{
+    std::vector<TValue> expected;
+    if (!ResolveLayerElement(pMesh, pElement, LayerElementResolver<TValue>::ePolygonVertex, expected))
+        return reader.find(mesh, semantic, set) == nullptr;
+    FbxbView<T> values = reader.values<T>(reader.find(mesh, semantic, set));
+    if (values.size() != expected.size() * components)
+        return false;
+    const double *flat = reinterpret_cast<const double *>(expected.data());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        for (int c = 0; c < components; c++)
+        {
+            if (values[i * components + c] != static_cast<T>(flat[i * LayerArrayTraits<TValue>::components + c]))
+                return false;
+        }
+    }
+    return true;
+}
+
+// what differs between one mesh and its fbxb entry, empty when nothing does
+template<class T>
+static std::string CompareFbxbMesh(const FbxbReader &reader, const FbxbMesh &mesh, FbxMesh *pMesh)
+{
+    if (mesh.controlPointCount != uint32_t(pMesh->GetControlPointsCount()) || mesh.polygonCount != uint32_t(pMesh->GetPolygonCount()) ||
+        mesh.polygonVertexCount != uint32_t(pMesh->GetPolygonVertexCount()))
+        return "counts";
+    if (std::string(reader.name(mesh)) != pMesh->GetName())
+        return "mesh name";
+    FbxbView<T> positions = reader.values<T>(reader.find(mesh, FbxbArray::ePositions));
+    if (positions.size() != size_t(pMesh->GetControlPointsCount()) * 3)
+        return "positions";
+    for (int i = 0; i < pMesh->GetControlPointsCount(); i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            if (positions[i * 3 + c] != static_cast<T>(pMesh->GetControlPointAt(i)[c]))
+                return "positions";
+        }
+    }
+    FbxbView<int32_t> vertices = reader.values<int32_t>(reader.find(mesh, FbxbArray::ePolygonVertices));
+    if (vertices.size() != size_t(pMesh->GetPolygonVertexCount()) ||
+        !std::equal(vertices.begin(), vertices.end(), pMesh->GetPolygonVertices()))
+        return "polygon vertices";
+    FbxbView<int32_t> offsets = reader.values<int32_t>(reader.find(mesh, FbxbArray::ePolygonOffsets));
+    if (offsets.size() != size_t(pMesh->GetPolygonCount()) + 1 || offsets[0] != 0)
+        return "polygon offsets";
+    for (int p = 0; p < pMesh->GetPolygonCount(); p++)
+    {
+        if (offsets[p + 1] - offsets[p] != pMesh->GetPolygonSize(p))
+            return "polygon offsets";
+    }
+    for (int k = 0; k < pMesh->GetElementNormalCount(); k++)
+    {
+        if (!SameFbxbElement<T>(reader, mesh, FbxbArray::eNormals, k, pMesh, pMesh->GetElementNormal(k), 3))
+            return "normals " + std::to_string(k);
+    }
+    for (int k = 0; k < pMesh->GetElementUVCount(); k++)
+    {
+        if (!SameFbxbElement<T>(reader, mesh, FbxbArray::eUVs, k, pMesh, pMesh->GetElementUV(k), 2))
+            return "uvs " + std::to_string(k);
+    }
+    for (int k = 0; k < pMesh->GetElementVertexColorCount(); k++)
+    {
+        if (!SameFbxbElement<T>(reader, mesh, FbxbArray::eColors, k, pMesh, pMesh->GetElementVertexColor(k), 4))
+            return "colors " + std::to_string(k);
+    }
+    return "";
+}
+
+// Writes `pScene` with allLayers the way --format fbxb does, maps the file
+// back through FbxbReader and compares every node, mesh and array with the
+// scene. Returns what differs, empty when the round trip is exact.
+static std::string CheckFbxbRoundTrip(FbxScene *pScene, bool float32)
+{
+    const char *path = "fbx2json_bench.fbxb";
+    ExportOptions options;
+    options.allLayers = true;
+    {
+        std::ofstream file(path, std::ios::out | std::ios::binary);
+        FbxbWriter::write(file, pScene, options, float32);
+        if (!file.good())
+            return std::string("cannot write ") + path;
+    }
+    std::string problem;
+    {
+        FbxbMappedFile file;
+        FbxbReader reader;
+        if (!file.open(path))
+            problem = std::string("cannot map ") + path;
+        else if (!reader.open(file.data(), file.size(), &problem))
+            problem = "cannot read back: " + problem;
+        else
+        {
+            // the reader lists nodes in preorder
+            std::vector<FbxNode *> nodes;
+            std::function<void(FbxNode *)> walk = [&](FbxNode *node) {
+                nodes.push_back(node);
+                for (int i = 0; i < node->GetChildCount(); i++)
+                    walk(node->GetChild(i));
+            };
+            walk(pScene->GetRootNode());
+            if (reader.nodes().size() != nodes.size())
+                problem = "node count";
+            for (size_t i = 0; i < nodes.size() && problem.empty(); i++)
+            {
+                const FbxbNode &node = reader.nodes()[i];
+                FbxMesh *pMesh = nodes[i]->GetMesh();
+                if (std::string(reader.name(node)) != nodes[i]->GetName() || (node.mesh < 0) != (pMesh == nullptr))
+                    problem = std::string("node ") + nodes[i]->GetName();
+                else if (pMesh)
+                    problem = float32 ? CompareFbxbMesh<float>(reader, reader.meshes()[node.mesh], pMesh)
+                                      : CompareFbxbMesh<double>(reader, reader.meshes()[node.mesh], pMesh);
+                if (!problem.empty() && pMesh)
+                    problem = std::string(nodes[i]->GetName()) + ": " + problem;
+            }
+        }
+    }
+    std::remove(path);
+    return problem;
+}
+
+// sums every value of every array so that all of them are read
+static double TouchFbxbArrays(const FbxbReader &reader)
+{
+    double sum = 0;
+    for (const FbxbMesh &mesh : reader.meshes())
+    {
+        for (const FbxbArray &array : reader.arrays(mesh))
+        {
+            switch (array.componentType)
+            {
+            case FbxbArray::eInt32:
+                for (int32_t v : reader.values<int32_t>(&array)) sum += v;
+                break;
+            case FbxbArray::eFloat32:
+                for (float v : reader.values<float>(&array)) sum += v;
+                break;
+            default:
+                for (double v : reader.values<double>(&array)) sum += v;
+                break;
+            }
+        }
+    }
+    return sum;
+}
+
+// Serialization alone: the scene is exported once into a recorder and a DOM,
+// then serialized by nlohmann::json and by the streaming writer in each float
+// format into a discarding stream. MB/s is output text per second.
+static void RunFormatBenchmarks(BenchRunner &runner, FbxScene *pScene, const std::string &name)
+{
+    if (!runner.selected("format/" + name))
+        return;
+    SceneRecorder recorder;
+    Fbx2Json::exportScene(recorder, pScene);
+    JsonDomWriter dom;
+    recorder.replay(dom);
+    double vertices = ControlPoints(pScene);
+    runner.run("format/" + name + "/nlohmann", vertices, [&]() {
+        CountingBuffer sink;
+        std::ostream stream(&sink);
+        stream << std::setw(4) << dom.result();
+        return sink.count;
+    });
+    std::vector<std::pair<std::string, FloatFormat>> formats(3);
+    formats[0].first = "shortest";
+    formats[1].first = "float32";
+    formats[1].second.float32 = true;
+    formats[2].first = "precision=6";
+    formats[2].second.precision = 6;
+    for (const auto &format : formats)
+    {
+        runner.run("format/" + name + "/" + format.first, vertices, [&]() {
+            CountingBuffer sink;
+            std::ostream stream(&sink);
+            OutputStream out(&stream);
+            JsonTextWriter writer(out, 4, format.second);
+            recorder.replay(writer);
+            out.flush();
+            return sink.count;
+        });
+    }
+
+    // each output encoding written by its streaming backend, then read back
+    // by the matching nlohmann parser; decode MB/s is encoded input per second
+    const OutputFormat encodings[] = {eJsonFormat, eCborFormat, eMsgPackFormat, eUbjsonFormat};
+    const char *encodingNames[] = {"json", "cbor", "msgpack", "ubjson"};
+    for (int e = 0; e < 4; e++)
+    {
+        std::string prefix = "format/" + name + "/";
+        if (!runner.selected(prefix + "encode/" + encodingNames[e]) && !runner.selected(prefix + "decode/" + encodingNames[e]))
+            continue;
+        runner.run(prefix + "encode/" + encodingNames[e], vertices, [&]() {
+            CountingBuffer sink;
+            std::ostream stream(&sink);
+            OutputStream out(&stream);
+            recorder.replay(*CreateSceneWriter(encodings[e], out, FloatFormat()));
+            out.flush();
+            return sink.count;
+        });
+        OutputStream encoded;
+        recorder.replay(*CreateSceneWriter(encodings[e], encoded, FloatFormat()));
+        const uint8_t *begin = reinterpret_cast<const uint8_t *>(encoded.data());
+        const uint8_t *end = begin + encoded.size();
+        runner.run(prefix + "decode/" + encodingNames[e], vertices, [&]() {
+            json j;
+            switch (encodings[e])
+            {
+            case eCborFormat: j = json::from_cbor(begin, end); break;
+            case eMsgPackFormat: j = json::from_msgpack(begin, end); break;
+            case eUbjsonFormat: j = json::from_ubjson(begin, end); break;
+            default: j = json::parse(begin, end); break;
+            }
+            return encoded.size();
+        });
+        printf("%-44s %12zu bytes\n", (prefix + encodingNames[e]).c_str(), encoded.size());
+    }
+
+    // fbxb is written from the scene rather than from the recorded events;
+    // decoding maps the file and reads every array
+    std::string prefix = "format/" + name + "/";
+    if (!runner.selected(prefix + "encode/fbxb") && !runner.selected(prefix + "decode/fbxb"))
+        return;
+    ExportOptions fbxbOptions;
+    fbxbOptions.allLayers = true;
+    runner.run(prefix + "encode/fbxb", vertices, [&]() {
+        std::stringstream stream(std::ios::in | std::ios::out | std::ios::binary);
+        return FbxbWriter::write(stream, pScene, fbxbOptions);
+    });
+    const char *fbxbPath = "fbx2json_bench.fbxb";
+    uint64_t fbxbBytes = 0;
+    {
+        std::ofstream file(fbxbPath, std::ios::out | std::ios::binary);
+        fbxbBytes = FbxbWriter::write(file, pScene, fbxbOptions);
+    }
+    volatile double touched = 0;
+    runner.run(prefix + "decode/fbxb", vertices, [&]() {
+        FbxbMappedFile file;
+        FbxbReader reader;
+        if (file.open(fbxbPath) && reader.open(file.data(), file.size()))
+            touched = TouchFbxbArrays(reader);
+        return file.size();
+    });
+    std::remove(fbxbPath);
+    printf("%-44s %12llu bytes\n", (prefix + "fbxb").c_str(), static_cast<unsigned long long>(fbxbBytes));
+}
+
+static void RunFormatBenchmarks(BenchRunner &runner, FbxManager *pManager, const std::string &input)
+{
+    std::string name = input.substr(input.find_last_of("/\\") + 1);
+    if (!runner.selected("format/" + name))
+        return;
+    FbxScene *pScene = FbxScene::Create(pManager, name.c_str());
+    int version = 0;
+    if (!LoadScene(pManager, pScene, input.c_str(), version))
+    {
+        std::cout << "skipping format/" << name << ", cannot load " << input << std::endl;
+        pScene->Destroy();
+        return;
+    }
+    RunFormatBenchmarks(runner, pScene, name);
+    pScene->Destroy();
+}
+
+static double Median(std::vector<double> v)
+{
+    std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+    return v[v.size() / 2];
+}
+
+// a "kB" field of /proc/self/status in bytes, 0 when there is none
+static uint64_t ProcStatusBytes(const char *field)
+{
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, std::strlen(field), field) == 0)
+            return std::stoull(line.substr(std::strlen(field))) * 1024;
+    }
+#endif
+    return 0;
+}
+
+// Linux can reset the peak RSS to the current one, so each import reports
+// the peak it added on top of what the bench already holds. Elsewhere it is
+// the process high-water mark.
+static void ResetPeakRss()
+{
+#ifdef __linux__
+    std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+static uint64_t PeakRss()
+{
+    uint64_t peak = ProcStatusBytes("VmHWM:");
+    return peak ? peak : ProcessUsage::now().peakRssBytes;
+}
+
+// lightest first, so a peak RSS that cannot be reset still grows with the profile
+static const char *importProfiles[] = {"geometry", "rig", "full"};
+
+static bool ImportSelected(const BenchRunner &runner, const std::string &name)
+{
+    for (const char *profile : importProfiles)
+    {
+        if (runner.selected("file/" + name + "/import/" + profile))
+            return true;
+    }
+    return false;
+}
+
+// LoadScene alone with each import profile: the median wall time over the
+// runs and the most peak RSS a run added
+static void RunImportBenchmarks(BenchRunner &runner, FbxManager *pManager, const std::string &input, int runs)
+{
+    std::string name = input.substr(input.find_last_of("/\\") + 1);
+    if (!ImportSelected(runner, name))
+        return;
+    if (!std::ifstream(input))
+    {
+        std::cout << "skipping " << input << ", file not found" << std::endl;
+        return;
+    }
+    for (const char *profile : importProfiles)
+    {
+        BenchResult result;
+        result.name = "file/" + name + "/import/" + profile;
+        if (!runner.selected(result.name))
+            continue;
+        ImportProfile importProfile = eImportFull;
+        ParseImportProfile(profile, importProfile);
+        std::vector<double> seconds;
+        for (int i = 0; i < runs; i++)
+        {
+            FbxScene *pScene = FbxScene::Create(pManager, name.c_str());
+            int version = 0;
+            ResetPeakRss();
+            uint64_t before = ProcStatusBytes("VmRSS:");
+            auto start = std::chrono::steady_clock::now();
+            bool loaded = LoadScene(pManager, pScene, input.c_str(), version, importProfile, false);
+            seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            result.peakRssBytes = std::max(result.peakRssBytes, PeakRss() - std::min(before, PeakRss()));
+            result.vertices = ControlPoints(pScene);
+            pScene->Destroy();
+            if (!loaded)
+            {
+                std::cout << "skipping " << result.name << ", cannot load " << input << std::endl;
+                return;
+            }
+        }
+        result.iterations = runs;
+        result.seconds = Median(seconds);
+        runner.add(result);
+    }
+}
+
+// load, validate, export and write through ConvertFile; phases are reported
+// separately with the median over the runs
+static void RunFileBenchmarks(BenchRunner &runner, FbxManager *pManager, const std::string &input, int runs)
+{
+    std::string name = input.substr(input.find_last_of("/\\") + 1);
+    if (!runner.selected("file/" + name))
+        return;
+    if (!std::ifstream(input))
+    {
+        std::cout << "skipping " << input << ", file not found" << std::endl;
+        return;
+    }
+
+    ConvertOptions options;
+    options.collectStats = true;
+    std::map<std::string, std::vector<double>> phases;
+    std::vector<double> totals;
+    ConvertResult last;
+    for (int i = 0; i < runs; i++)
+    {
+        last = ConvertFile(pManager, input, "fbx2json_bench.json", options);
+        if (!last.success)
+        {
+            std::cout << "skipping " << input << ", " << last.error << std::endl;
+            return;
+        }
+        for (const PhaseStats &phase : last.stats.phases)
+            phases[phase.name].push_back(phase.wallSeconds);
+        totals.push_back(last.seconds);
+    }
+    std::remove("fbx2json_bench.json");
+
+    double vertices = 0;
+    for (const MeshStats &mesh : last.stats.meshes.meshes())
+        vertices += mesh.controlPoints;
+    for (const PhaseStats &phase : last.stats.phases)
+    {
+        BenchResult result;
+        result.name = "file/" + name + "/" + phase.name;
+        result.iterations = runs;
+        result.seconds = Median(phases[phase.name]);
+        result.vertices = vertices;
+        result.bytes = phase.name == "write" || phase.name == "export" ? double(last.stats.jsonBytes) : 0;
+        runner.add(result);
+    }
+    BenchResult total;
+    total.name = "file/" + name + "/total";
+    total.iterations = runs;
+    total.seconds = Median(totals);
+    total.vertices = vertices;
+    total.bytes = double(last.stats.jsonBytes);
+    runner.add(total);
+}
+
+int main(int argc, char **argv)
+{
+    cxxopts::Options options(argv[0], " - fbx2json benchmarks");
+    options.add_options()
+        ("help,h", "Print help")
+        ("filter", "Only run benchmarks whose name contains this string", cxxopts::value<std::string>()->default_value(""))
+        ("min-time", "Minimum seconds spent on each benchmark", cxxopts::value<double>()->default_value("0.5"))
+        ("grid", "Edge length of the generated grid meshes", cxxopts::value<int>()->default_value("512"))
+        ("fbx", "FBX files for the end-to-end benchmarks (repeatable)", cxxopts::value<std::vector<std::string>>())
+        ("runs", "Conversions per FBX file", cxxopts::value<int>()->default_value("5"))
+        ("json", "Write the results to this JSON file", cxxopts::value<std::string>());
+
+    auto result = options.parse(argc, argv);
+    if (result.count("help"))
+    {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    FbxManager *pManager = nullptr;
+    InitializeSdkManager(pManager);
+
+    BenchRunner runner(result["filter"].as<std::string>(), result["min-time"].as<double>());
+    int grid = std::max(8, result["grid"].as<int>());
+    BenchRunner::printHeader();
+    RunMicroBenchmarks(runner, pManager, grid);
+    RunGeneratedBenchmarks(runner, pManager, grid);
+
+    std::vector<std::string> files;
+    if (result.count("fbx"))
+        files = result["fbx"].as<std::vector<std::string>>();
+    else
+        files.push_back(FBX2JSON_BENCH_FBX);
+    for (const std::string &file : files)
+    {
+        RunImportBenchmarks(runner, pManager, file, std::max(1, result["runs"].as<int>()));
+        RunFileBenchmarks(runner, pManager, file, std::max(1, result["runs"].as<int>()));
+        if (std::ifstream(file))
+            RunFormatBenchmarks(runner, pManager, file);
+    }
+    {
+        FbxScene *pScene = SceneGenerator(BenchScene(16, grid / 2)).generate(pManager);
+        RunFormatBenchmarks(runner, pScene, "generated");
+        pScene->Destroy();
+    }
+
+    // a failed round trip fails the run, whatever the filter
+    bool fbxbExact = true;
+    {
+        GeneratorOptions generatorOptions = BenchScene(4, 16);
+        generatorOptions.minPolygonSize = 3;
+        generatorOptions.maxPolygonSize = 6;
+        generatorOptions.instances = 2;
+        generatorOptions.hierarchy = GeneratorOptions::eBalanced;
+        FbxScene *pScene = SceneGenerator(generatorOptions).generate(pManager);
+        for (bool float32 : {false, true})
+        {
+            std::string problem = CheckFbxbRoundTrip(pScene, float32);
+            printf("%-44s %s\n", float32 ? "check/fbxb/float32" : "check/fbxb/float64", problem.empty() ? "ok" : problem.c_str());
+            fbxbExact = fbxbExact && problem.empty();
+        }
+        pScene->Destroy();
+    }
+
+    // the same pipeline over a generated file, so it runs without assets
+    if (runner.selected("file/fbx2json_bench.fbx") || ImportSelected(runner, "fbx2json_bench.fbx"))
+    {
+        FbxScene *pScene = SceneGenerator(BenchScene(16, grid / 2)).generate(pManager);
+        bool saved = SaveScene(pManager, pScene, "fbx2json_bench.fbx", -1);
+        pScene->Destroy();
+        if (saved)
+        {
+            RunImportBenchmarks(runner, pManager, "fbx2json_bench.fbx", std::max(1, result["runs"].as<int>()));
+            RunFileBenchmarks(runner, pManager, "fbx2json_bench.fbx", std::max(1, result["runs"].as<int>()));
+        }
+        std::remove("fbx2json_bench.fbx");
+    }
+
+    DestroySdkObjects(pManager, true);
+
+    if (result.count("json"))
+    {
+        std::ofstream out(result["json"].as<std::string>());
+        out << runner.toJson().dump(4) << std::endl;
+        if (!out.good())
+        {
+            std::cout << "Cannot write " << result["json"].as<std::string>() << std::endl;
+            return 1;
+        }
+    }
+    return fbxbExact ? 0 : 1;
+}
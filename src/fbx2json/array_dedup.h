@@ -0,0 +1,506 @@
+#pragma once
+#include <fbxsdk.h>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "./layer_array.h"
+#include "./scene_writer.h"
+#include "./stats.h"
+#include "./thread_pool.h"
+#include "./trace.h"
+
+// 128-bit content hash of a bulk array. Equal hashes only make arrays
+// candidates for sharing, their bytes are compared before.
+struct ArrayHash
+{
+	uint64_t low = 0;
+	uint64_t high = 0;
+
+	bool operator==(const ArrayHash &other) const { return low == other.low && high == other.high; }
+
+	// four independent xxHash64 style lanes over 32-byte stripes, finished
+	// into two differently mixed halves
+	static ArrayHash of(const void *data, size_t size)
+	{
+		const uint64_t p1 = 0x9e3779b185ebca87ull, p2 = 0xc2b2ae3d27d4eb4full, p3 = 0x165667b19e3779f9ull;
+		const char *p = static_cast<const char *>(data);
+		uint64_t v[4] = {p1 + p2, p2, 0, 0 - p1};
+		size_t i = 0;
+		for (; i + 32 <= size; i += 32)
+		{
+			for (int lane = 0; lane < 4; lane++)
+				v[lane] = round(v[lane], word(p + i + lane * 8));
+		}
+		for (int lane = 0; i + 8 <= size; i += 8, lane = (lane + 1) % 4)
+			v[lane] = round(v[lane], word(p + i));
+		if (i < size)
+		{
+			char tail[8] = {};
+			std::memcpy(tail, p + i, size - i);
+			v[0] = round(v[0], word(tail));
+		}
+		ArrayHash h;
+		h.low = avalanche(rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18) + size * p3);
+		h.high = avalanche((v[0] ^ rotl(v[1], 29)) * p1 + (v[2] ^ rotl(v[3], 41)) * p2 + size);
+		return h;
+	}
+
+private:
+	static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+	static uint64_t word(const char *p)
+	{
+		uint64_t w;
+		std::memcpy(&w, p, 8);
+		return w;
+	}
+	static uint64_t round(uint64_t acc, uint64_t input)
+	{
+		return rotl(acc + input * 0xc2b2ae3d27d4eb4full, 31) * 0x9e3779b185ebca87ull;
+	}
+	static uint64_t avalanche(uint64_t h)
+	{
+		h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdull;
+		h = (h ^ (h >> 33)) * 0xc4ceb9fe1a85ec53ull;
+		return h ^ (h >> 33);
+	}
+};
+
+// The raw arrays one exported array is computed from and how, as the
+// exporter describes them for ArrayDedup. Exported arrays with the same
+// transform and byte-identical blocks are identical.
+struct ArraySource
+{
+	// the array below its mesh object, keys and indices joined with '/'
+	std::string path;
+	// how the blocks become the array, e.g. "ints" or "doubles/4"
+	std::string transform;
+	// about the size of the array inline
+	size_t bytes = 0;
+	std::vector<std::pair<const void *, size_t>> blocks;
+
+	ArraySource &block(const void *data, size_t size)
+	{
+		blocks.emplace_back(data, size);
+		return *this;
+	}
+};
+
+// The sources of every array of one mesh. Blocks point into the mesh, into
+// `owned` or into layer arrays kept locked, and stay valid while this lives.
+struct MeshSources
+{
+	std::vector<ArraySource> arrays;
+
+	ArraySource &add(const std::string &path, const std::string &transform, size_t bytes)
+	{
+		arrays.emplace_back();
+		arrays.back().path = path;
+		arrays.back().transform = transform;
+		arrays.back().bytes = bytes;
+		return arrays.back();
+	}
+	// keeps values the SDK computes rather than stores, e.g. polygon sizes
+	const int *own(std::vector<int> values)
+	{
+		owned.push_back(std::move(values));
+		return owned.back().data();
+	}
+	// the layer array's storage, read-locked until this is destroyed
+	template <class T>
+	std::pair<const void *, size_t> lock(const FbxLayerElementArrayTemplate<T> &array)
+	{
+		std::shared_ptr<LayerArrayReader<T>> reader = std::make_shared<LayerArrayReader<T>>(array);
+		locks.push_back(reader);
+		return std::make_pair(static_cast<const void *>(reader->data()), static_cast<size_t>(reader->count()) * sizeof(T));
+	}
+
+private:
+	std::list<std::vector<int>> owned;
+	std::vector<std::shared_ptr<void>> locks;
+};
+
+// Finds bulk arrays that are byte-identical across meshes, e.g. meshes that
+// were copied instead of instanced. A pre-pass on a thread pool hashes the
+// raw SDK arrays every exported array is computed from, so no mesh is
+// triangulated or welded twice, and compares the bytes of every match
+// before sharing it. Arrays occurring more than once become entries of a
+// shared array table in the order the export first reaches them. While
+// exporting, each occurrence is replaced by {"sharedArray": index}. Arrays
+// the exporter does not describe are always written inline.
+class ArrayDedup
+{
+	struct MeshState;
+	struct Slot;
+
+public:
+	typedef std::function<void(FbxMesh *, MeshSources &)> DescribeMesh;
+
+	// arrays smaller than this stay inline, a reference is about as large
+	static const size_t minSharedBytes = 64;
+
+	// `meshes` lists every mesh in the order the export writes them
+	ArrayDedup(const std::vector<FbxMesh *> &meshes, unsigned threads, DescribeMesh describe)
+	{
+		TraceScope trace("export", "dedupArrays");
+		std::vector<FbxMesh *> distinct;
+		for (FbxMesh *mesh : meshes)
+		{
+			if (mMeshes.emplace(mesh, MeshState()).second)
+				distinct.push_back(mesh);
+			mMeshes[mesh].occurrences++;
+		}
+		std::vector<std::vector<Entry>> entries(distinct.size());
+		ThreadPool pool(threads);
+		pool.parallelFor(distinct.size(), 1, [&](size_t i) {
+			TraceScope meshTrace("export", "hashArrays", distinct[i]->GetName());
+			MeshSources sources;
+			describe(distinct[i], sources);
+			for (size_t k = 0; k < sources.arrays.size(); k++)
+			{
+				const ArraySource &array = sources.arrays[k];
+				if (array.bytes < minSharedBytes)
+					continue;
+				Entry entry;
+				entry.mesh = i;
+				entry.array = k;
+				entry.path = array.path;
+				entry.key.transform = array.transform;
+				for (const auto &block : array.blocks)
+				{
+					entry.key.bytes += block.second;
+					entry.key.hash = combine(entry.key.hash, ArrayHash::of(block.first, block.second));
+				}
+				entries[i].push_back(entry);
+			}
+		});
+
+		// the first entry of every key in export order owns it, the others
+		// join it once their bytes are compared
+		std::unordered_map<Key, const Entry *, KeyHash> owners;
+		for (auto &list : entries)
+		{
+			for (Entry &entry : list)
+			{
+				auto inserted = owners.emplace(entry.key, &entry);
+				entry.owner = inserted.first->second;
+			}
+		}
+		pool.parallelFor(distinct.size(), 1, [&](size_t i) {
+			verify(distinct, describe, entries[i]);
+		});
+
+		std::unordered_map<const Entry *, int> uses;
+		for (const auto &list : entries)
+		{
+			for (const Entry &entry : list)
+			{
+				if (entry.owner)
+					uses[entry.owner] += mMeshes[distinct[entry.mesh]].occurrences;
+			}
+		}
+		std::unordered_map<const Entry *, int> slotOf;
+		for (const auto &list : entries)
+		{
+			for (const Entry &entry : list)
+			{
+				if (entry.owner == nullptr || uses[entry.owner] < 2)
+					continue;
+				auto inserted = slotOf.emplace(entry.owner, static_cast<int>(mTable.size()));
+				if (inserted.second)
+					mTable.emplace_back(new Slot(distinct[entry.owner->mesh], entry.owner->path));
+				mMeshes[distinct[entry.mesh]].slots[entry.path] = inserted.first->second;
+			}
+		}
+	}
+
+	// what was shared, complete once every mesh has been written
+	DedupStats stats() const
+	{
+		DedupStats stats;
+		stats.sharedArrays = mTable.size();
+		for (const auto &mesh : mMeshes)
+		{
+			const MeshState &state = mesh.second;
+			stats.arrays += state.occurrences * state.arrays;
+			stats.references += state.occurrences * state.references;
+			stats.bytesSaved += state.occurrences * state.referencedBytes - state.ownedBytes;
+		}
+		return stats;
+	}
+
+	// Forwards one mesh to `inner`, replacing shared arrays with references
+	// and capturing the first occurrence of each into the table. Writers for
+	// different meshes may run on different threads.
+	class MeshWriter : public SceneWriter
+	{
+	public:
+		MeshWriter(SceneWriter &inner, ArrayDedup &dedup, FbxMesh *mesh)
+			: mInner(inner), mDedup(dedup), mMesh(mesh), mState(dedup.mMeshes.at(mesh))
+		{
+		}
+
+		void startObject(size_t elements) override
+		{
+			mLevels.push_back(Level(next(), false));
+			mInner.startObject(elements);
+		}
+		void endObject() override
+		{
+			mInner.endObject();
+			end();
+		}
+		void startArray(size_t elements) override
+		{
+			mLevels.push_back(Level(next(), true));
+			mInner.startArray(elements);
+		}
+		void endArray() override
+		{
+			mInner.endArray();
+			end();
+		}
+		void key(const std::string &name) override
+		{
+			mLevels.back().key = name;
+			mInner.key(name);
+		}
+
+		void null() override
+		{
+			skip();
+			mInner.null();
+		}
+		void boolean(bool value) override
+		{
+			skip();
+			mInner.boolean(value);
+		}
+		void numberInteger(int64_t value) override
+		{
+			skip();
+			mInner.numberInteger(value);
+		}
+		void numberFloat(double value) override
+		{
+			skip();
+			mInner.numberFloat(value);
+		}
+		void string(const std::string &value) override
+		{
+			skip();
+			mInner.string(value);
+		}
+
+		void intArray(const int *data, size_t count, int components = 1) override
+		{
+			if (SceneWriter *w = target(count * components * sizeof(int)))
+				w->intArray(data, count, components);
+		}
+		void floatArray(const double *data, size_t count, int components = 1) override
+		{
+			if (SceneWriter *w = target(count * components * sizeof(double)))
+				w->floatArray(data, count, components);
+		}
+		void polygonArray(const int *data, size_t count, size_t polygonCount) override
+		{
+			if (SceneWriter *w = target(count * sizeof(int)))
+				w->polygonArray(data, count, polygonCount);
+		}
+
+	private:
+		// an open container below the mesh object and its path
+		struct Level
+		{
+			Level(const std::string &p, bool a) : path(p), array(a), elements(0) {}
+			std::string path;
+			bool array;
+			size_t elements;
+			std::string key;
+		};
+
+		// the path of the value about to start
+		std::string next()
+		{
+			if (mLevels.empty())
+				return std::string();
+			Level &level = mLevels.back();
+			std::string name = level.array ? std::to_string(level.elements++) : level.key;
+			return level.path.empty() ? name : level.path + "/" + name;
+		}
+		void skip()
+		{
+			if (!mLevels.empty() && mLevels.back().array)
+				mLevels.back().elements++;
+		}
+		void end()
+		{
+			mLevels.pop_back();
+			// a mesh written again, e.g. an instance, was counted already
+			if (mLevels.empty())
+				mState.counted = true;
+		}
+
+		// where the next array goes: the inner writer, the table when this is
+		// its first occurrence, or nowhere once the reference is written
+		SceneWriter *target(size_t bytes)
+		{
+			std::string path = next();
+			bool count = !mState.counted;
+			if (count)
+				mState.arrays++;
+			auto it = mState.slots.find(path);
+			if (it == mState.slots.end())
+				return &mInner;
+			int slot = it->second;
+			mInner.startObject(1);
+			mInner.key("sharedArray");
+			mInner.numberInteger(slot);
+			mInner.endObject();
+			if (count)
+			{
+				mState.references++;
+				mState.referencedBytes += bytes;
+			}
+			// the owning mesh is only ever exported by one thread at a time
+			Slot &s = *mDedup.mTable[slot];
+			if (s.mesh != mMesh || s.path != path || s.filled)
+				return nullptr;
+			s.filled = true;
+			mState.ownedBytes += bytes;
+			return &s.data;
+		}
+
+		SceneWriter &mInner;
+		ArrayDedup &mDedup;
+		FbxMesh *mMesh;
+		MeshState &mState;
+		std::vector<Level> mLevels;
+	};
+
+	// The shared array table, once every mesh has been written.
+	void writeTable(SceneWriter &w) const
+	{
+		w.startArray(mTable.size());
+		for (const auto &slot : mTable)
+			slot->data.replay(w);
+		w.endArray();
+	}
+
+private:
+	struct Key
+	{
+		std::string transform;
+		size_t bytes = 0;
+		ArrayHash hash;
+
+		bool operator==(const Key &other) const
+		{
+			return bytes == other.bytes && hash == other.hash && transform == other.transform;
+		}
+	};
+	struct KeyHash
+	{
+		size_t operator()(const Key &key) const { return static_cast<size_t>(key.hash.low); }
+	};
+	// an array of a distinct mesh large enough to share
+	struct Entry
+	{
+		// index into the distinct meshes and into their sources
+		size_t mesh = 0;
+		size_t array = 0;
+		std::string path;
+		Key key;
+		// the entry with the same bytes first in export order, itself for
+		// that one, null when only the hashes matched
+		const Entry *owner = nullptr;
+	};
+
+	static ArrayHash combine(const ArrayHash &seed, const ArrayHash &h)
+	{
+		const uint64_t words[4] = {seed.low, seed.high, h.low, h.high};
+		return ArrayHash::of(words, sizeof(words));
+	}
+
+	// compares the blocks of every entry with those of its owner and drops
+	// the owner of those that differ
+	static void verify(const std::vector<FbxMesh *> &distinct, const DescribeMesh &describe, std::vector<Entry> &entries)
+	{
+		MeshSources mine;
+		std::unordered_map<size_t, std::unique_ptr<MeshSources>> theirs;
+		bool described = false;
+		for (Entry &entry : entries)
+		{
+			if (entry.owner == &entry)
+				continue;
+			if (!described)
+			{
+				describe(distinct[entry.mesh], mine);
+				described = true;
+			}
+			const MeshSources *owner = &mine;
+			if (entry.owner->mesh != entry.mesh)
+			{
+				std::unique_ptr<MeshSources> &sources = theirs[entry.owner->mesh];
+				if (!sources)
+				{
+					sources.reset(new MeshSources());
+					describe(distinct[entry.owner->mesh], *sources);
+				}
+				owner = sources.get();
+			}
+			if (!sameBytes(mine.arrays[entry.array], owner->arrays[entry.owner->array]))
+				entry.owner = nullptr;
+		}
+	}
+
+	static bool sameBytes(const ArraySource &a, const ArraySource &b)
+	{
+		size_t ia = 0, ib = 0, oa = 0, ob = 0;
+		while (true)
+		{
+			while (ia < a.blocks.size() && oa == a.blocks[ia].second)
+				ia++, oa = 0;
+			while (ib < b.blocks.size() && ob == b.blocks[ib].second)
+				ib++, ob = 0;
+			if (ia == a.blocks.size() || ib == b.blocks.size())
+				return ia == a.blocks.size() && ib == b.blocks.size();
+			size_t n = std::min(a.blocks[ia].second - oa, b.blocks[ib].second - ob);
+			if (std::memcmp(static_cast<const char *>(a.blocks[ia].first) + oa, static_cast<const char *>(b.blocks[ib].first) + ob, n) != 0)
+				return false;
+			oa += n;
+			ob += n;
+		}
+	}
+
+	// a table entry and the array occurrence that fills it
+	struct Slot
+	{
+		Slot(FbxMesh *m, const std::string &p) : mesh(m), path(p), filled(false) {}
+		FbxMesh *mesh;
+		std::string path;
+		bool filled;
+		SceneRecorder data;
+	};
+
+	// per distinct mesh; counted the first time it is written
+	struct MeshState
+	{
+		size_t occurrences = 0;
+		// table index of each shared array by path
+		std::unordered_map<std::string, int> slots;
+		bool counted = false;
+		size_t arrays = 0;
+		size_t references = 0;
+		uint64_t referencedBytes = 0;
+		// of the arrays it filled the table with
+		uint64_t ownedBytes = 0;
+	};
+
+	std::unordered_map<FbxMesh *, MeshState> mMeshes;
+	std::vector<std::unique_ptr<Slot>> mTable;
+};
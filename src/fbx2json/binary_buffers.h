@@ -0,0 +1,92 @@
+#pragma once
+#include <cstring>
+#include "./scene_writer.h"
+
+// Forwards the event stream to another writer but moves bulk arrays into a
+// companion binary file. Each array is replaced by a reference object
+//   {"buffer": <file>, "byteOffset": n, "count": n, "componentType": t, "components": n}
+// pointing at little-endian data aligned to 8 bytes. Polygons keep the FBX
+// PolygonVertexIndex encoding (last vertex of a polygon stored as ~index).
+class BinaryBufferWriter : public SceneWriter
+{
+public:
+	BinaryBufferWriter(SceneWriter &inner, OutputStream &bin, const std::string &bufferName)
+		: mInner(inner), mBin(bin), mBufferName(bufferName)
+	{
+	}
+
+	void startObject(size_t elements) override { mInner.startObject(elements); }
+	void endObject() override { mInner.endObject(); }
+	void startArray(size_t elements) override { mInner.startArray(elements); }
+	void endArray() override { mInner.endArray(); }
+	void key(const std::string &name) override { mInner.key(name); }
+
+	void null() override { mInner.null(); }
+	void boolean(bool value) override { mInner.boolean(value); }
+	void numberInteger(int64_t value) override { mInner.numberInteger(value); }
+	void numberFloat(double value) override { mInner.numberFloat(value); }
+	void string(const std::string &value) override { mInner.string(value); }
+
+	void intArray(const int *data, size_t count, int components = 1) override
+	{
+		writeReference(appendBlob(data, count * components), count, "int32", components);
+	}
+	void floatArray(const double *data, size_t count, int components = 1) override
+	{
+		writeReference(appendBlob(data, count * components), count, "float64", components);
+	}
+	void polygonArray(const int *data, size_t count, size_t) override
+	{
+		writeReference(appendBlob(data, count), count, "int32", 1);
+	}
+
+private:
+	template <class T>
+	size_t appendBlob(const T *data, size_t count)
+	{
+		static const char padding[8] = {};
+		size_t misalign = mBin.tell() % 8;
+		if (misalign)
+			mBin.write(padding, 8 - misalign);
+		size_t offset = mBin.tell();
+		if (isLittleEndian())
+		{
+			mBin.write(reinterpret_cast<const char *>(data), count * sizeof(T));
+			return offset;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			char bytes[sizeof(T)];
+			std::memcpy(bytes, &data[i], sizeof(T));
+			for (size_t b = sizeof(T); b > 0; b--)
+				mBin.put(bytes[b - 1]);
+		}
+		return offset;
+	}
+
+	void writeReference(size_t offset, size_t count, const char *componentType, int components)
+	{
+		mInner.startObject(5);
+		mInner.key("buffer");
+		mInner.string(mBufferName);
+		mInner.key("byteOffset");
+		mInner.numberInteger(offset);
+		mInner.key("count");
+		mInner.numberInteger(count);
+		mInner.key("componentType");
+		mInner.string(componentType);
+		mInner.key("components");
+		mInner.numberInteger(components);
+		mInner.endObject();
+	}
+
+	static bool isLittleEndian()
+	{
+		const uint16_t probe = 1;
+		return *reinterpret_cast<const uint8_t *>(&probe) == 1;
+	}
+
+	SceneWriter &mInner;
+	OutputStream &mBin;
+	std::string mBufferName;
+};
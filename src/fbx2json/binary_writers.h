@@ -0,0 +1,523 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include "./json_writer.h"
+#include "./scene_writer.h"
+
+// Encodings the exporter can stream a scene into.
+enum OutputFormat
+{
+	eJsonFormat,
+	eCborFormat,
+	eMsgPackFormat,
+	eUbjsonFormat,
+	// the mappable table layout of fbxb_format.h, written by FbxbWriter
+	eFbxbFormat,
+};
+
+// json, cbor, msgpack, ubjson or fbxb
+inline bool ParseOutputFormat(const std::string &name, OutputFormat &format)
+{
+	if (name == "json") format = eJsonFormat;
+	else if (name == "cbor") format = eCborFormat;
+	else if (name == "msgpack") format = eMsgPackFormat;
+	else if (name == "ubjson") format = eUbjsonFormat;
+	else if (name == "fbxb") format = eFbxbFormat;
+	else return false;
+	return true;
+}
+
+// output file extension, dot included
+inline const char *OutputFormatExtension(OutputFormat format)
+{
+	switch (format)
+	{
+	case eCborFormat: return ".cbor";
+	case eMsgPackFormat: return ".msgpack";
+	case eUbjsonFormat: return ".ubj";
+	case eFbxbFormat: return ".fbxb";
+	default: return ".json";
+	}
+}
+
+// Shared plumbing of the binary encodings. TWriter provides arrayHeader(n),
+// integer(v) and floating(v); bulk arrays are written through them without a
+// virtual call per value. No encoding depends on where a value sits, so
+// fragments are encoded into memory and spliced in as raw bytes.
+template <class TWriter>
+class BinarySceneWriter : public SceneWriter
+{
+public:
+	BinarySceneWriter(OutputStream &out, bool float32) : mOut(out), mFloat32(float32) {}
+
+	void intArray(const int *data, size_t count, int components = 1) override
+	{
+		TWriter &w = static_cast<TWriter &>(*this);
+		w.arrayHeader(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (components != 1)
+				w.arrayHeader(components);
+			for (int c = 0; c < components; c++)
+				w.integer(data[i * components + c]);
+		}
+	}
+	void floatArray(const double *data, size_t count, int components = 1) override
+	{
+		TWriter &w = static_cast<TWriter &>(*this);
+		w.arrayHeader(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (components != 1)
+				w.arrayHeader(components);
+			for (int c = 0; c < components; c++)
+				w.floating(data[i * components + c]);
+		}
+	}
+	void polygonArray(const int *data, size_t count, size_t polygonCount) override
+	{
+		TWriter &w = static_cast<TWriter &>(*this);
+		w.arrayHeader(polygonCount);
+		size_t begin = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (data[i] >= 0)
+				continue;
+			w.arrayHeader(i + 1 - begin);
+			for (; begin < i; begin++)
+				w.integer(data[begin]);
+			w.integer(~data[i]);
+			begin = i + 1;
+		}
+	}
+
+	std::unique_ptr<SceneWriter> createFragment() override
+	{
+		return std::unique_ptr<SceneWriter>(new Fragment(mFloat32));
+	}
+	void writeFragment(const SceneWriter &fragment) override
+	{
+		const OutputStream &buffer = static_cast<const Fragment &>(fragment).buffer;
+		mOut.write(buffer.data(), buffer.size());
+	}
+
+protected:
+	void byte(uint8_t value) { mOut.put(static_cast<char>(value)); }
+	// all three encodings store numbers big-endian
+	template <class TUint>
+	void bigEndian(TUint value)
+	{
+		char *p = mOut.reserve(sizeof(TUint));
+		for (size_t i = 0; i < sizeof(TUint); i++)
+			p[i] = static_cast<char>(value >> (8 * (sizeof(TUint) - 1 - i)));
+		mOut.commit(p + sizeof(TUint));
+	}
+	void bigEndianFloat(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		bigEndian(bits);
+	}
+	void bigEndianDouble(double value)
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		bigEndian(bits);
+	}
+	// finite values in float range that lose nothing as floats, or lose
+	// what --float32 allows them to
+	bool asFloat(double value) const
+	{
+		if (!(value >= std::numeric_limits<float>::lowest() && value <= std::numeric_limits<float>::max()))
+			return false;
+		return mFloat32 || static_cast<double>(static_cast<float>(value)) == value;
+	}
+
+	OutputStream &mOut;
+	bool mFloat32;
+
+private:
+	// the writer over its own buffer; the base only keeps a reference to it
+	struct Fragment : TWriter
+	{
+		explicit Fragment(bool float32) : TWriter(buffer, float32) {}
+		OutputStream buffer;
+	};
+};
+
+// RFC 8949 CBOR with definite lengths, byte-identical to json::to_cbor of
+// the same document.
+class CborWriter : public BinarySceneWriter<CborWriter>
+{
+public:
+	explicit CborWriter(OutputStream &out, bool float32 = false) : BinarySceneWriter(out, float32) {}
+
+	void startObject(size_t elements) override { header(5, elements); }
+	void endObject() override {}
+	void startArray(size_t elements) override { header(4, elements); }
+	void endArray() override {}
+	void key(const std::string &name) override { string(name); }
+
+	void null() override { byte(0xF6); }
+	void boolean(bool value) override { byte(value ? 0xF5 : 0xF4); }
+	void numberInteger(int64_t value) override { integer(value); }
+	void numberFloat(double value) override { floating(value); }
+	void string(const std::string &value) override
+	{
+		header(3, value.size());
+		mOut.write(value.data(), value.size());
+	}
+
+	void arrayHeader(size_t elements) { header(4, elements); }
+	void integer(int64_t value)
+	{
+		if (value >= 0)
+			header(0, static_cast<uint64_t>(value));
+		else
+			header(1, static_cast<uint64_t>(-1 - value));
+	}
+	void floating(double value)
+	{
+		if (std::isnan(value))
+		{
+			// half precision NaN and infinities
+			byte(0xF9);
+			byte(0x7E);
+			byte(0x00);
+		}
+		else if (std::isinf(value))
+		{
+			byte(0xF9);
+			byte(value > 0 ? 0x7C : 0xFC);
+			byte(0x00);
+		}
+		else if (asFloat(value))
+		{
+			byte(0xFA);
+			bigEndianFloat(static_cast<float>(value));
+		}
+		else
+		{
+			byte(0xFB);
+			bigEndianDouble(value);
+		}
+	}
+
+private:
+	// major type and argument in the shortest form
+	void header(uint8_t major, uint64_t argument)
+	{
+		uint8_t type = static_cast<uint8_t>(major << 5);
+		if (argument <= 0x17)
+		{
+			byte(static_cast<uint8_t>(type | argument));
+		}
+		else if (argument <= 0xFF)
+		{
+			byte(type | 24);
+			bigEndian(static_cast<uint8_t>(argument));
+		}
+		else if (argument <= 0xFFFF)
+		{
+			byte(type | 25);
+			bigEndian(static_cast<uint16_t>(argument));
+		}
+		else if (argument <= 0xFFFFFFFF)
+		{
+			byte(type | 26);
+			bigEndian(static_cast<uint32_t>(argument));
+		}
+		else
+		{
+			byte(type | 27);
+			bigEndian(argument);
+		}
+	}
+};
+
+// MessagePack, byte-identical to json::to_msgpack of the same document.
+class MsgPackWriter : public BinarySceneWriter<MsgPackWriter>
+{
+public:
+	explicit MsgPackWriter(OutputStream &out, bool float32 = false) : BinarySceneWriter(out, float32) {}
+
+	void startObject(size_t elements) override { header(0x80, 15, 0xDE, elements); }
+	void endObject() override {}
+	void startArray(size_t elements) override { header(0x90, 15, 0xDC, elements); }
+	void endArray() override {}
+	void key(const std::string &name) override { string(name); }
+
+	void null() override { byte(0xC0); }
+	void boolean(bool value) override { byte(value ? 0xC3 : 0xC2); }
+	void numberInteger(int64_t value) override { integer(value); }
+	void numberFloat(double value) override { floating(value); }
+	void string(const std::string &value) override
+	{
+		size_t size = value.size();
+		if (size <= 31)
+		{
+			byte(static_cast<uint8_t>(0xA0 | size));
+		}
+		else if (size <= 0xFF)
+		{
+			byte(0xD9);
+			bigEndian(static_cast<uint8_t>(size));
+		}
+		else
+		{
+			header(0, 0, 0xDA, size);
+		}
+		mOut.write(value.data(), size);
+	}
+
+	void arrayHeader(size_t elements) { header(0x90, 15, 0xDC, elements); }
+	void integer(int64_t value)
+	{
+		if (value >= 0)
+		{
+			if (value <= 0x7F)
+				byte(static_cast<uint8_t>(value));
+			else if (value <= 0xFF)
+			{
+				byte(0xCC);
+				bigEndian(static_cast<uint8_t>(value));
+			}
+			else if (value <= 0xFFFF)
+			{
+				byte(0xCD);
+				bigEndian(static_cast<uint16_t>(value));
+			}
+			else if (value <= 0xFFFFFFFF)
+			{
+				byte(0xCE);
+				bigEndian(static_cast<uint32_t>(value));
+			}
+			else
+			{
+				byte(0xCF);
+				bigEndian(static_cast<uint64_t>(value));
+			}
+		}
+		else if (value >= -32)
+			byte(static_cast<uint8_t>(value));
+		else if (value >= std::numeric_limits<int8_t>::min())
+		{
+			byte(0xD0);
+			bigEndian(static_cast<uint8_t>(value));
+		}
+		else if (value >= std::numeric_limits<int16_t>::min())
+		{
+			byte(0xD1);
+			bigEndian(static_cast<uint16_t>(value));
+		}
+		else if (value >= std::numeric_limits<int32_t>::min())
+		{
+			byte(0xD2);
+			bigEndian(static_cast<uint32_t>(value));
+		}
+		else
+		{
+			byte(0xD3);
+			bigEndian(static_cast<uint64_t>(value));
+		}
+	}
+	void floating(double value)
+	{
+		if (asFloat(value))
+		{
+			byte(0xCA);
+			bigEndianFloat(static_cast<float>(value));
+		}
+		else
+		{
+			byte(0xCB);
+			bigEndianDouble(value);
+		}
+	}
+
+private:
+	// fix form up to `fixMax` elements, else the 16 bit form `code` or the
+	// 32 bit form code + 1
+	void header(uint8_t fix, size_t fixMax, uint8_t code, size_t elements)
+	{
+		if (elements <= fixMax)
+		{
+			byte(static_cast<uint8_t>(fix | elements));
+		}
+		else if (elements <= 0xFFFF)
+		{
+			byte(code);
+			bigEndian(static_cast<uint16_t>(elements));
+		}
+		else
+		{
+			byte(static_cast<uint8_t>(code + 1));
+			bigEndian(static_cast<uint32_t>(elements));
+		}
+	}
+};
+
+// UBJSON with counted containers, since every size is known up front. Bulk
+// arrays and their tuples are strongly typed: floats as 'D' (or 'd' with
+// float32), ints as the narrowest type that holds all of them, so readers
+// can copy them in one block. json::from_ubjson reads it back.
+class UbjsonWriter : public BinarySceneWriter<UbjsonWriter>
+{
+public:
+	explicit UbjsonWriter(OutputStream &out, bool float32 = false) : BinarySceneWriter(out, float32) {}
+
+	void startObject(size_t elements) override
+	{
+		byte('{');
+		count(elements);
+	}
+	void endObject() override {}
+	void startArray(size_t elements) override { arrayHeader(elements); }
+	void endArray() override {}
+	void key(const std::string &name) override
+	{
+		integer(static_cast<int64_t>(name.size()));
+		mOut.write(name.data(), name.size());
+	}
+
+	void null() override { byte('Z'); }
+	void boolean(bool value) override { byte(value ? 'T' : 'F'); }
+	void numberInteger(int64_t value) override { integer(value); }
+	void numberFloat(double value) override { floating(value); }
+	void string(const std::string &value) override
+	{
+		byte('S');
+		key(value);
+	}
+
+	void intArray(const int *data, size_t count, int components = 1) override
+	{
+		int lMin = 0, lMax = 0;
+		for (size_t i = 0; i < count * components; i++)
+		{
+			lMin = std::min(lMin, data[i]);
+			lMax = std::max(lMax, data[i]);
+		}
+		char type = lMin >= std::numeric_limits<int8_t>::min() && lMax <= std::numeric_limits<int8_t>::max() ? 'i'
+			: lMin >= 0 && lMax <= 0xFF ? 'U'
+			: lMin >= std::numeric_limits<int16_t>::min() && lMax <= std::numeric_limits<int16_t>::max() ? 'I'
+			: 'l';
+		if (components != 1)
+			arrayHeader(count);
+		for (size_t i = 0; i < (components != 1 ? count : 1); i++)
+		{
+			size_t n = components != 1 ? components : count;
+			typedHeader(type, n);
+			const int *values = data + i * components;
+			for (size_t k = 0; k < n; k++)
+			{
+				switch (type)
+				{
+				case 'i': bigEndian(static_cast<uint8_t>(values[k])); break;
+				case 'U': bigEndian(static_cast<uint8_t>(values[k])); break;
+				case 'I': bigEndian(static_cast<uint16_t>(values[k])); break;
+				default: bigEndian(static_cast<uint32_t>(values[k])); break;
+				}
+			}
+		}
+	}
+	void floatArray(const double *data, size_t count, int components = 1) override
+	{
+		if (components != 1)
+			arrayHeader(count);
+		for (size_t i = 0; i < (components != 1 ? count : 1); i++)
+		{
+			size_t n = components != 1 ? components : count;
+			typedHeader(mFloat32 ? 'd' : 'D', n);
+			const double *values = data + i * components;
+			for (size_t k = 0; k < n; k++)
+			{
+				if (mFloat32)
+					bigEndianFloat(static_cast<float>(values[k]));
+				else
+					bigEndianDouble(values[k]);
+			}
+		}
+	}
+
+	void arrayHeader(size_t elements)
+	{
+		byte('[');
+		count(elements);
+	}
+	// the narrowest integer type, as json::to_ubjson picks it
+	void integer(int64_t value)
+	{
+		if (value >= std::numeric_limits<int8_t>::min() && value <= std::numeric_limits<int8_t>::max())
+		{
+			byte('i');
+			bigEndian(static_cast<uint8_t>(value));
+		}
+		else if (value >= 0 && value <= 0xFF)
+		{
+			byte('U');
+			bigEndian(static_cast<uint8_t>(value));
+		}
+		else if (value >= std::numeric_limits<int16_t>::min() && value <= std::numeric_limits<int16_t>::max())
+		{
+			byte('I');
+			bigEndian(static_cast<uint16_t>(value));
+		}
+		else if (value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max())
+		{
+			byte('l');
+			bigEndian(static_cast<uint32_t>(value));
+		}
+		else
+		{
+			byte('L');
+			bigEndian(static_cast<uint64_t>(value));
+		}
+	}
+	void floating(double value)
+	{
+		if (mFloat32 && asFloat(value))
+		{
+			byte('d');
+			bigEndianFloat(static_cast<float>(value));
+		}
+		else
+		{
+			byte('D');
+			bigEndianDouble(value);
+		}
+	}
+
+private:
+	void count(size_t elements)
+	{
+		byte('#');
+		integer(static_cast<int64_t>(elements));
+	}
+	// [$<type>#<count>, the values follow without markers
+	void typedHeader(char type, size_t elements)
+	{
+		byte('[');
+		byte('$');
+		byte(static_cast<uint8_t>(type));
+		count(elements);
+	}
+};
+
+// the writer for `format` over `out`, JSON for fbxb, which is not an event
+// stream; binary encodings only honour float32 of the float format
+inline std::unique_ptr<SceneWriter> CreateSceneWriter(OutputFormat format, OutputStream &out, const FloatFormat &floatFormat)
+{
+	switch (format)
+	{
+	case eCborFormat: return std::unique_ptr<SceneWriter>(new CborWriter(out, floatFormat.float32));
+	case eMsgPackFormat: return std::unique_ptr<SceneWriter>(new MsgPackWriter(out, floatFormat.float32));
+	case eUbjsonFormat: return std::unique_ptr<SceneWriter>(new UbjsonWriter(out, floatFormat.float32));
+	default: return std::unique_ptr<SceneWriter>(new JsonTextWriter(out, 4, floatFormat));
+	}
+}
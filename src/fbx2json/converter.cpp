@@ -0,0 +1,199 @@
+#include "./converter.h"
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include "./binary_buffers.h"
+#include "./fbxb_writer.h"
+#include "./json_toc.h"
+
+static std::string ReplaceExtension(const std::string &path, const std::string &extension)
+{
+    size_t slash = path.find_last_of("/\\");
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return path + extension;
+    return path.substr(0, dot) + extension;
+}
+
+static std::string FileName(const std::string &path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+std::string BinaryBufferPath(const std::string &output)
+{
+    return ReplaceExtension(output, ".bin");
+}
+
+std::string TocPath(const std::string &output)
+{
+    return ReplaceExtension(output, ".toc.json");
+}
+
+std::string DefaultOutputPath(const std::string &input, OutputFormat format)
+{
+    return ReplaceExtension(input, OutputFormatExtension(format));
+}
+
+// fbxb files carry their arrays themselves, binaryBuffers does not apply
+static bool WriteFbxbScene(FbxScene *pScene, const std::string &output, const ExportOptions &exportOptions, const ConvertOptions &options,
+    ConvertResult &result)
+{
+    PhaseTimer exportTimer;
+    std::ofstream file(output, std::ios::out | std::ios::binary);
+    {
+        TraceScope trace("phase", "export");
+        result.stats.jsonBytes = FbxbWriter::write(file, pScene, exportOptions, options.floatFormat.float32);
+    }
+    result.stats.phases.push_back(exportTimer.stop("export"));
+
+    PhaseTimer writeTimer;
+    TraceScope trace("phase", "write");
+    file.close();
+    bool written = file.good();
+    if (!written)
+        result.error = "Failed to write " + output;
+    result.stats.phases.push_back(writeTimer.stop("write"));
+    return written;
+}
+
+static bool WriteScene(FbxScene *pScene, const std::string &output, const ConvertOptions &options, ConvertResult &result)
+{
+    ExportOptions exportOptions = options.exportOptions;
+    if (options.collectStats)
+        exportOptions.stats = &result.stats.meshes;
+    exportOptions.dedupStats = &result.stats.dedup;
+    if (options.format == eFbxbFormat)
+        return WriteFbxbScene(pScene, output, exportOptions, options, result);
+
+    PhaseTimer exportTimer;
+    std::ofstream file(output, options.format == eJsonFormat ? std::ios::out : std::ios::out | std::ios::binary);
+    OutputStream out(&file);
+    std::unique_ptr<SceneWriter> writer = CreateSceneWriter(options.format, out, options.floatFormat);
+    std::string binPath = BinaryBufferPath(output);
+    std::ofstream binFile;
+    std::unique_ptr<OutputStream> bin;
+    std::unique_ptr<BinaryBufferWriter> binWriter;
+    if (options.binaryBuffers)
+    {
+        binFile.open(binPath, std::ios::binary);
+        bin.reset(new OutputStream(&binFile));
+        binWriter.reset(new BinaryBufferWriter(*writer, *bin, FileName(binPath)));
+    }
+    SceneWriter *target = binWriter ? binWriter.get() : writer.get();
+    // offsets are only known for JSON text
+    std::unique_ptr<JsonTocWriter> tocWriter;
+    if (options.toc && options.format == eJsonFormat)
+    {
+        tocWriter.reset(new JsonTocWriter(*target, static_cast<JsonTextWriter &>(*writer)));
+        target = tocWriter.get();
+    }
+    {
+        TraceScope trace("phase", "export");
+        Fbx2Json::exportScene(*target, pScene, exportOptions);
+    }
+    result.stats.phases.push_back(exportTimer.stop("export"));
+
+    PhaseTimer writeTimer;
+    TraceScope trace("phase", "write");
+    bool written = true;
+    if (bin)
+    {
+        bin->flush();
+        binFile.close();
+        result.stats.binBytes = bin->tell();
+        if (!bin->good())
+        {
+            result.error = "Failed to write " + binPath;
+            written = false;
+        }
+    }
+    out.flush();
+    file.close();
+    result.stats.jsonBytes = out.tell();
+    if (written && !out.good())
+    {
+        result.error = "Failed to write " + output;
+        written = false;
+    }
+    if (written && tocWriter)
+    {
+        std::string tocPath = TocPath(output);
+        std::ofstream tocFile(tocPath);
+        OutputStream tocOut(&tocFile);
+        JsonTextWriter tocText(tocOut);
+        tocWriter->writeToc(tocText, FileName(output));
+        tocOut.flush();
+        result.stats.tocBytes = tocOut.tell();
+        if (!tocOut.good())
+        {
+            result.error = "Failed to write " + tocPath;
+            written = false;
+        }
+    }
+    result.stats.phases.push_back(writeTimer.stop("write"));
+    return written;
+}
+
+static bool ValidateScene(FbxScene *pScene, const ConvertOptions &options, std::string &error)
+{
+    TraceScope trace("phase", "validation");
+    switch (options.validation)
+    {
+    case eValidateNone:
+        return true;
+    case eValidateFull:
+        if (CheckSceneIntegrity(pScene))
+            return true;
+        error = "Scene integrity verification failed";
+        return false;
+    case eValidateFast:
+        break;
+    }
+    std::vector<std::string> errors;
+    if (SceneValidator::validateScene(pScene, options.exportOptions.threads, errors))
+        return true;
+    FBXSDK_printf("Scene validation failed with the following errors:\n");
+    for (const std::string &e : errors)
+        FBXSDK_printf("   %s\n", e.c_str());
+    error = "Scene validation failed: " + errors.front();
+    return false;
+}
+
+ConvertResult ConvertFile(FbxManager *pManager, const std::string &input, const std::string &output, const ConvertOptions &options)
+{
+    auto start = std::chrono::steady_clock::now();
+    ConvertResult result;
+    TraceScope trace("phase", "convert", input.c_str());
+
+    PhaseTimer importTimer;
+    FbxScene *pScene = FbxScene::Create(pManager, "");
+    int fbxFileVersion = -1;
+    ImportProfile profile = options.autoImportProfile ? Fbx2Json::requiredImportProfile(options.exportOptions) : options.importProfile;
+    bool loaded;
+    {
+        TraceScope importTrace("phase", "import");
+        loaded = LoadScene(pManager, pScene, input.c_str(), fbxFileVersion, profile, false);
+    }
+    result.stats.phases.push_back(importTimer.stop("import"));
+    result.importSeconds = result.stats.phases.back().wallSeconds;
+    if (loaded)
+    {
+        PhaseTimer validateTimer;
+        bool valid = ValidateScene(pScene, options, result.error);
+        result.stats.phases.push_back(validateTimer.stop("validation"));
+        result.validateSeconds = result.stats.phases.back().wallSeconds;
+        if (valid)
+            result.success = WriteScene(pScene, output, options, result);
+    }
+    else
+    {
+        result.error = "Failed to load " + input;
+    }
+    // destroys everything imported into the scene, the manager stays warm
+    pScene->Destroy();
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include "./binary_writers.h"
+#include "./fbx2json.h"
+#include "./scene_validator.h"
+#include "./stats.h"
+
+struct ConvertOptions
+{
+	ExportOptions exportOptions;
+	// write large arrays to a companion .bin file
+	bool binaryBuffers = false;
+	// write a byte-offset table of contents of JSON output to a .toc.json file
+	bool toc = false;
+	// how the JSON text spells numbers, binary buffers keep full doubles
+	FloatFormat floatFormat;
+	// encoding of the output file, the binary ones only honour float32
+	OutputFormat format = eJsonFormat;
+	// import only what the export reads, otherwise use importProfile
+	bool autoImportProfile = true;
+	ImportProfile importProfile = eImportFull;
+	// checks run on the imported scene before it is exported
+	ValidationMode validation = eValidateFull;
+	// fill ConvertResult::stats with per-mesh entries, phases are always timed
+	bool collectStats = false;
+};
+
+struct ConvertResult
+{
+	bool success = false;
+	std::string error;
+	double seconds = 0;
+	// part of seconds spent in LoadScene
+	double importSeconds = 0;
+	// part of seconds spent validating the imported scene
+	double validateSeconds = 0;
+	ConvertStats stats;
+};
+
+// Loads `input` into a fresh scene of `pManager`, writes it to `output` and
+// destroys the scene again, so one manager can convert any number of files.
+ConvertResult ConvertFile(FbxManager *pManager, const std::string &input, const std::string &output, const ConvertOptions &options);
+
+// companion file next to the output: scene.json -> scene.bin
+std::string BinaryBufferPath(const std::string &output);
+
+// table of contents next to the output: scene.json -> scene.toc.json
+std::string TocPath(const std::string &output);
+
+// input.fbx -> input.json, input.cbor, ...
+std::string DefaultOutputPath(const std::string &input, OutputFormat format = eJsonFormat);
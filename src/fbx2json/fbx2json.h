@@ -1,72 +1,246 @@
 #pragma once
-#include <json.hpp>
+#include "./array_dedup.h"
 #include "./fbx_common.h"
-using json = nlohmann::ordered_json;
+#include "./json_writer.h"
+#include "./layer_array.h"
+#include "./layer_element.h"
+#include "./node_filter.h"
+#include "./node_table.h"
+#include "./parallel_export.h"
+#include "./point_adjacency.h"
+#include "./stats.h"
+#include "./trace.h"
+#include "./triangulator.h"
+#include "./vertex_buffer.h"
+
+struct ExportOptions
+{
+	enum PolygonLayout
+	{
+		// one array per polygon
+		eNestedPolygons,
+		// flat polygonVertexIndices plus polygonCount+1 polygonOffsets,
+		// or a single polygonSize when every polygon has the same size
+		eCsrPolygons,
+	};
+	PolygonLayout polygonLayout = eNestedPolygons;
+	enum VertexBufferLayout
+	{
+		eNoVertexBuffer,
+		// welded vertices as one array of interleaved attribute tuples
+		eInterleavedVertices,
+		// welded vertices as one array per attribute
+		eSeparateVertexStreams,
+	};
+	// adds a "vertexBuffer" with welded vertices and an index buffer to meshes
+	VertexBufferLayout vertexBuffer = eNoVertexBuffer;
+	// also export normals, tangents, binormals, smoothing and material layers
+	bool allLayers = false;
+	// adds "pointAdjacency" to meshes: the polygon vertices of every control
+	// point as CSR offsets and polygonVertices
+	bool pointAdjacency = false;
+	// writes meshes as triangles: polygons, point adjacency, the vertex
+	// buffer and layer elements mapped by polygon vertex or by polygon all
+	// follow the triangles. Elements mapped by edge are written unchanged.
+	bool triangulate = false;
+	// meshes are exported on a thread pool unless this is 1, 0 uses all cores
+	unsigned threads = 1;
+	// nodes to export, everything by default
+	NodeFilter filter;
+	// receives per-mesh counts and export times when set
+	ExportStats *stats = nullptr;
+	// exportScene writes every distinct mesh once into a top-level "meshes"
+	// table, with its FBX unique ID, and nodes refer to it by index
+	bool meshTable = false;
+	// exportScene writes the hierarchy as a flat preorder "nodes" table
+	// instead of a nested "RootNode"; implies meshTable
+	bool nodeTable = false;
+	// exportScene writes arrays that occur more than once, byte for byte,
+	// into a top-level "sharedArrays" table and refers to them by index
+	bool dedupArrays = false;
+	// receives what dedupArrays found when set
+	DedupStats *dedupStats = nullptr;
+};
+
+// none, interleaved or separate
+inline bool ParseVertexBufferLayout(const std::string &name, ExportOptions::VertexBufferLayout &layout)
+{
+	if (name == "none") layout = ExportOptions::eNoVertexBuffer;
+	else if (name == "interleaved") layout = ExportOptions::eInterleavedVertices;
+	else if (name == "separate") layout = ExportOptions::eSeparateVertexStreams;
+	else return false;
+	return true;
+}
 
 class Fbx2Json
 {
 public:
-	static json exportNode(FbxNode *node)
+	static void exportNode(SceneWriter &w, FbxNode *node, const ExportOptions &options = ExportOptions())
 	{
-		json j = {};
-		j["name"] = node->GetName();
-		j["mesh"] = exportMesh(node->GetMesh());
-		std::vector<json> childrenData;
-		for (int i = 0; i < node->GetChildCount(); i++)
+		ExportState state(options, node);
+		exportTree(w, node, state);
+	}
+
+	// {"meshes": [...], "RootNode": {...}, "sharedArrays": [...]}, the mesh
+	// and shared array tables only when enabled; "nodes": {...} replaces
+	// "RootNode" with a node table
+	static void exportScene(SceneWriter &w, FbxScene *pScene, const ExportOptions &options = ExportOptions())
+	{
+		FbxNode *root = pScene->GetRootNode();
+		ExportState state(options, root);
+		bool meshTable = options.meshTable || options.nodeTable;
+		std::vector<FbxMesh*> meshes;
+		NodeTable nodes;
+		if (options.nodeTable)
+		{
+			NodeTable::build(root, [&state](FbxNode *node) { return state.contains(node); },
+				[&state](FbxNode *node) { return state.meshOf(node); }, nodes);
+			for (FbxMesh *pMesh : nodes.meshes)
+			{
+				if (pMesh)
+					meshes.push_back(pMesh);
+			}
+		}
+		else if (meshTable || options.dedupArrays)
+			collectMeshes(root, state, meshes);
+		std::unordered_map<FbxMesh*, int64_t> index;
+		std::vector<FbxMesh*> table;
+		if (meshTable)
+		{
+			for (FbxMesh *pMesh : meshes)
+			{
+				if (index.emplace(pMesh, static_cast<int64_t>(table.size())).second)
+					table.push_back(pMesh);
+			}
+		}
+		std::unique_ptr<ArrayDedup> dedup;
+		if (options.dedupArrays)
+		{
+			// the pre-pass sees the meshes as often and in the order they are written
+			dedup.reset(new ArrayDedup(meshTable ? table : meshes, options.threads,
+				[&options](FbxMesh *mesh, MeshSources &sources) { describeMesh(mesh, options, sources); }));
+			state.dedup = dedup.get();
+		}
+
+		w.startObject(1 + (meshTable ? 1 : 0) + (dedup ? 1 : 0));
+		if (meshTable)
+		{
+			w.key("meshes");
+			exportMeshTable(w, table, state);
+			state.meshIndex = &index;
+		}
+		if (options.nodeTable)
 		{
-			childrenData.push_back(exportNode(node->GetChild(i)));
+			w.key("nodes");
+			exportNodeTable(w, nodes, index);
 		}
-		j["children"] = json(childrenData);
-		return j;
+		else
+		{
+			w.key("RootNode");
+			exportTree(w, root, state);
+		}
+		if (dedup)
+		{
+			w.key("sharedArrays");
+			dedup->writeTable(w);
+			if (options.dedupStats)
+				*options.dedupStats = dedup->stats();
+		}
+		w.endObject();
 	}
 
-	static json exportScene(FbxScene *pScene)
+	static json exportNode(FbxNode *node, const ExportOptions &options = ExportOptions())
 	{
-		json j = {};
-		j["RootNode"] = exportNode(pScene->GetRootNode());
-		return j;
+		JsonDomWriter w;
+		exportNode(w, node, options);
+		return std::move(w.result());
 	}
 
-	static json dumpIndexArray(const FbxLayerElementArrayTemplate<int>& indexArray)
+	static json exportScene(FbxScene *pScene, const ExportOptions &options = ExportOptions())
 	{
-		std::vector<int> indexData;
-		indexData.reserve(indexArray.GetCount());
-		for (int i = 0; i < indexArray.GetCount(); ++i) {
-			indexData.push_back(indexArray.GetAt(i));
-		}
-		return json(indexData);
+		JsonDomWriter w;
+		exportScene(w, pScene, options);
+		return std::move(w.result());
+	}
+
+	// Every exported field comes from nodes, meshes and their layer elements;
+	// animation, deformers and textures are never read.
+	static ImportProfile requiredImportProfile(const ExportOptions &)
+	{
+		return eImportGeometry;
 	}
-	static json dumpColorArray(const FbxLayerElementArrayTemplate<FbxColor>& colorArray)
+
+	static void dumpIndexArray(SceneWriter &w, const FbxLayerElementArrayTemplate<int>& indexArray)
 	{
-		std::vector<json> colorData;
-		colorData.reserve(colorArray.GetCount());
-		for (int i = 0; i < colorArray.GetCount(); ++i) {
-			const FbxColor& c = colorArray.GetAt(i);
-			colorData.push_back(json({ c.mRed,c.mGreen,c.mBlue,c.mAlpha }));
-		}
-		return json(colorData);
+		dumpLayerArray(w, indexArray);
 	}
-	static json dumpVector2Array(const FbxLayerElementArrayTemplate<FbxVector2>& v2Array)
+	static void dumpColorArray(SceneWriter &w, const FbxLayerElementArrayTemplate<FbxColor>& colorArray)
 	{
-		std::vector<json> data;
-		data.reserve(v2Array.GetCount());
-		for (int i = 0; i < v2Array.GetCount(); ++i) {
-			const auto& c = v2Array.GetAt(i);
-			data.push_back(json({ c[0],c[1] }));
-		}
-		return json(data);
+		dumpLayerArray(w, colorArray);
+	}
+	static void dumpVector2Array(SceneWriter &w, const FbxLayerElementArrayTemplate<FbxVector2>& v2Array)
+	{
+		dumpLayerArray(w, v2Array);
+	}
+	static void dumpVector4Array(SceneWriter &w, const FbxLayerElementArrayTemplate<FbxVector4>& vectorArray)
+	{
+		dumpLayerArray(w, vectorArray);
+	}
+
+	// any layer element array in one bulk write from its locked storage
+	template<class T>
+	static void dumpLayerArray(SceneWriter &w, const FbxLayerElementArrayTemplate<T>& array)
+	{
+		LayerArrayReader<T> reader(array);
+		writeComponents(w, reader.flat(), reader.count(), reader.components);
 	}
 
-	template<class V>
-	static json dumpVector4Array(const FbxLayerElementArrayTemplate<FbxVector4>& vectorArray)
+	// array[remap[0]], array[remap[1]], ...; the array as is without a remap.
+	// Callers check remapFits first, so every remap index is in range.
+	template<class T>
+	static void dumpLayerArray(SceneWriter &w, const FbxLayerElementArrayTemplate<T>& array, const std::vector<int> *remap)
 	{
-		std::vector<json> data;
-		data.reserve(vectorArray.GetCount());
-		for (int i = 0; i < vectorArray.GetCount(); ++i) {
-			const auto& c = vectorArray.GetAt(i);
-			data.push_back(json({ c[0],c[1],c[2],c[3] }));
+		LayerArrayReader<T> reader(array);
+		if (remap == nullptr) {
+			writeComponents(w, reader.flat(), reader.count(), reader.components);
+			return;
 		}
-		return json(data);
+		std::vector<T> values;
+		values.reserve(remap->size());
+		for (int i : *remap)
+			values.push_back(reader.data()[i]);
+		writeComponents(w, reinterpret_cast<const typename LayerArrayReader<T>::Component*>(values.data()),
+			static_cast<int>(values.size()), reader.components);
+	}
+
+	// what each triangulated value of an element comes from: polygon
+	// vertices for elements mapped by polygon vertex, polygons for those
+	// mapped by polygon, nothing for the rest
+	static const std::vector<int> *triangulatedSource(FbxLayerElement *elem, const Triangulation *pTriangles)
+	{
+		if (pTriangles == nullptr || !followsTriangles(elem))
+			return nullptr;
+		return elem->GetMappingMode() == FbxLayerElement::eByPolygonVertex ? &pTriangles->corners : &pTriangles->polygons;
+	}
+	static bool followsTriangles(FbxLayerElement *elem)
+	{
+		return elem->GetMappingMode() == FbxLayerElement::eByPolygonVertex || elem->GetMappingMode() == FbxLayerElement::eByPolygon;
+	}
+	// Whether an element with `count` values in the array triangles pick from
+	// has one for every polygon vertex or polygon its mapping mode covers.
+	// Elements that do not are left out of triangulated meshes, with a
+	// warning when `key` names them.
+	static bool remapFits(FbxMesh *pFbxMesh, FbxLayerElement *elem, int count, const char *key = nullptr)
+	{
+		if (!followsTriangles(elem))
+			return true;
+		int expected = elem->GetMappingMode() == FbxLayerElement::eByPolygonVertex ? pFbxMesh->GetPolygonVertexCount() : pFbxMesh->GetPolygonCount();
+		if (count >= expected)
+			return true;
+		if (key)
+			FBXSDK_printf("Warning: mesh '%s': %s '%s' has %d values, its mapping mode needs %d; left out of the triangulated mesh\n",
+				pFbxMesh->GetName(), key, elem->GetName(), count, expected);
+		return false;
 	}
 
 	static std::string MappingModeEnumString(FbxLayerElement::EMappingMode mode) {
@@ -89,138 +263,602 @@ public:
 		return strERefMode[mode];
 	}
 
+	// Color of one polygon vertex from the first vertex color element, for
+	// elements mapped by control point or polygon vertex. Use
+	// resolveVertexColors for whole meshes.
 	static bool getVertexColors(FbxMesh *pMesh, int lControlPointIndex, int vertexId, FbxColor &out)
 	{
 		FbxGeometryElementVertexColor *leVtxc = pMesh->GetElementVertexColor(0);
-		FbxGeometryElementVertexColor * pLayerVertex = pMesh->GetLayer(0)->GetVertexColors();
-		switch (leVtxc->GetMappingMode())
+		if (leVtxc == nullptr)
+			return false;
+		int lIndex;
+		if (leVtxc->GetMappingMode() == FbxGeometryElement::eByControlPoint)
+			lIndex = lControlPointIndex;
+		else if (leVtxc->GetMappingMode() == FbxGeometryElement::eByPolygonVertex)
+			lIndex = vertexId;
+		else
+			return false;
+		if (leVtxc->GetReferenceMode() == FbxGeometryElement::eIndexToDirect)
+			lIndex = leVtxc->GetIndexArray().GetAt(lIndex);
+		else if (leVtxc->GetReferenceMode() != FbxGeometryElement::eDirect)
+			return false;
+		out = leVtxc->GetDirectArray().GetAt(lIndex);
+		return true;
+	}
+
+	// one color per polygon vertex from vertex color element `element`
+	static bool resolveVertexColors(FbxMesh *pMesh, std::vector<FbxColor> &out, int element = 0)
+	{
+		return ResolveLayerElement(pMesh, pMesh->GetElementVertexColor(element),
+			LayerElementResolver<FbxColor>::ePolygonVertex, out);
+	}
+
+	static void exportMesh(SceneWriter &w, FbxMesh *pFbxMesh, const ExportOptions &options = ExportOptions())
+	{
+		exportMeshObject(w, pFbxMesh, options, false);
+	}
+
+	static json exportMesh(FbxMesh *pFbxMesh, const ExportOptions &options = ExportOptions())
+	{
+		JsonDomWriter w;
+		exportMesh(w, pFbxMesh, options);
+		return std::move(w.result());
+	}
+
+private:
+	// `withId` adds the FBX unique ID, for mesh table entries; large meshes
+	// are triangulated on `pool` when one is given
+	static void exportMeshObject(SceneWriter &w, FbxMesh *pFbxMesh, const ExportOptions &options, bool withId,
+		ThreadPool *pool = nullptr)
+	{
+		if (pFbxMesh == nullptr) {
+			w.null();
+			return;
+		}
+		TraceScope trace("export", "exportMesh", pFbxMesh->GetName());
+		if (options.stats == nullptr) {
+			writeMesh(w, pFbxMesh, options, withId, pool);
+			return;
+		}
+		auto start = std::chrono::steady_clock::now();
+		int lVertices = writeMesh(w, pFbxMesh, options, withId, pool);
+		options.stats->addMesh(pFbxMesh, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), lVertices);
+	}
+
+	// returns the number of welded vertices, 0 without a vertex buffer
+	static int writeMesh(SceneWriter &w, FbxMesh *pFbxMesh, const ExportOptions &options, bool withId, ThreadPool *pool)
+	{
+		Triangulation triangulation;
+		const Triangulation *pTriangles = nullptr;
+		if (options.triangulate) {
+			TraceScope trace("layer", "triangulate");
+			Triangulator::build(pFbxMesh, triangulation, pool);
+			pTriangles = &triangulation;
+		}
+
+		bool csr = options.polygonLayout == ExportOptions::eCsrPolygons;
+		bool vertexBuffer = options.vertexBuffer != ExportOptions::eNoVertexBuffer;
+		w.startObject((withId ? 1 : 0) + (csr ? 6 : 5) + (options.pointAdjacency ? 1 : 0) + (options.allLayers ? 5 : 0) +
+			(vertexBuffer ? 1 : 0));
+		if (withId) {
+			w.key("id");
+			w.numberInteger(static_cast<int64_t>(pFbxMesh->GetUniqueID()));
+		}
+		w.key("name");
+		w.string(pFbxMesh->GetName());
+
+		//control points, FbxVector4 is four packed doubles
 		{
-		case FbxGeometryElement::eByControlPoint:
-			switch (leVtxc->GetReferenceMode())
-			{
-				case FbxGeometryElement::eDirect:
-					out = leVtxc->GetDirectArray().GetAt(lControlPointIndex);
-					return true;
-				case FbxGeometryElement::eIndexToDirect:
-				{
-					int id = leVtxc->GetIndexArray().GetAt(lControlPointIndex);
-					out = leVtxc->GetDirectArray().GetAt(id);
-					return true;
-				}
-				break;
-			default:
-				break; // other reference modes not shown here!
+			TraceScope trace("layer", "controlPoints");
+			w.key("controlPoints");
+			w.floatArray(reinterpret_cast<const double*>(pFbxMesh->GetControlPoints()), pFbxMesh->GetControlPointsCount(), 4);
+		}
+
+		//ploygons
+		if (pTriangles) {
+			exportTriangles(w, pFbxMesh, *pTriangles, csr);
+		}
+		else if (csr) {
+			exportCsrPolygons(w, pFbxMesh);
+		}
+		else {
+			exportNestedPolygons(w, pFbxMesh);
+		}
+		if (options.pointAdjacency) {
+			exportPointAdjacency(w, pFbxMesh, pTriangles);
+		}
+
+		exportLayerElements(w, pFbxMesh, "vertexColors", pFbxMesh->GetElementVertexColorCount(),
+			[pFbxMesh](int i) { return pFbxMesh->GetElementVertexColor(i); }, pTriangles);
+		exportLayerElements(w, pFbxMesh, "uv", pFbxMesh->GetElementUVCount(),
+			[pFbxMesh](int i) { return pFbxMesh->GetElementUV(i); }, pTriangles);
+
+		if (options.allLayers) {
+			exportLayerElements(w, pFbxMesh, "normals", pFbxMesh->GetElementNormalCount(),
+				[pFbxMesh](int i) { return pFbxMesh->GetElementNormal(i); }, pTriangles);
+			exportLayerElements(w, pFbxMesh, "tangents", pFbxMesh->GetElementTangentCount(),
+				[pFbxMesh](int i) { return pFbxMesh->GetElementTangent(i); }, pTriangles);
+			exportLayerElements(w, pFbxMesh, "binormals", pFbxMesh->GetElementBinormalCount(),
+				[pFbxMesh](int i) { return pFbxMesh->GetElementBinormal(i); }, pTriangles);
+			exportLayerElements(w, pFbxMesh, "smoothing", pFbxMesh->GetElementSmoothingCount(),
+				[pFbxMesh](int i) { return pFbxMesh->GetElementSmoothing(i); }, pTriangles);
+			exportMaterialElements(w, pFbxMesh, pTriangles);
+		}
+		int lVertices = vertexBuffer ? exportVertexBuffer(w, pFbxMesh, options, pTriangles) : 0;
+		w.endObject();
+		return lVertices;
+	}
+
+	// The raw arrays behind the arrays writeMesh writes, for ArrayDedup; paths
+	// and transforms follow writeMesh. Point adjacency and vertex buffers
+	// combine too much to be worth describing and are always written inline.
+	static void describeMesh(FbxMesh *pFbxMesh, const ExportOptions &options, MeshSources &sources)
+	{
+		bool csr = options.polygonLayout == ExportOptions::eCsrPolygons;
+		const void *pPoints = pFbxMesh->GetControlPoints();
+		size_t lPointBytes = static_cast<size_t>(pFbxMesh->GetControlPointsCount()) * sizeof(FbxVector4);
+		const int *pVertices = pFbxMesh->GetPolygonVertices();
+		size_t lVertexBytes = static_cast<size_t>(pFbxMesh->GetPolygonVertexCount()) * sizeof(int);
+		std::vector<int> sizes;
+		sizes.reserve(pFbxMesh->GetPolygonCount());
+		bool uniform = true;
+		for (int i = 0; i < pFbxMesh->GetPolygonCount(); i++) {
+			sizes.push_back(pFbxMesh->GetPolygonSize(i));
+			uniform = uniform && sizes.back() == sizes.front();
+		}
+		size_t lSizeBytes = sizes.size() * sizeof(int);
+		const int *pSizes = sources.own(std::move(sizes));
+
+		sources.add("controlPoints", "doubles/4", lPointBytes).block(pPoints, lPointBytes);
+		// triangles depend on the positions as well as the polygons
+		ArraySource triangles;
+		if (options.triangulate) {
+			triangles.block(pPoints, lPointBytes).block(pVertices, lVertexBytes).block(pSizes, lSizeBytes);
+			sources.add(csr ? "polygonVertexIndices" : "polygons", csr ? "triangles/csr" : "triangles", lVertexBytes).blocks = triangles.blocks;
+		}
+		else if (csr) {
+			sources.add("polygonVertexIndices", "ints", lVertexBytes).block(pVertices, lVertexBytes);
+			if (!uniform)
+				sources.add("polygonOffsets", "offsets", lSizeBytes).block(pSizes, lSizeBytes);
+		}
+		else {
+			sources.add("polygons", "nested", lVertexBytes).block(pVertices, lVertexBytes).block(pSizes, lSizeBytes);
+		}
+
+		const ArraySource *pTriangles = options.triangulate ? &triangles : nullptr;
+		describeLayerElements(sources, pFbxMesh, "vertexColors", pFbxMesh->GetElementVertexColorCount(),
+			[pFbxMesh](int i) { return pFbxMesh->GetElementVertexColor(i); }, pTriangles);
+		describeLayerElements(sources, pFbxMesh, "uv", pFbxMesh->GetElementUVCount(),
+			[pFbxMesh](int i) { return pFbxMesh->GetElementUV(i); }, pTriangles);
+		if (options.allLayers) {
+			describeLayerElements(sources, pFbxMesh, "normals", pFbxMesh->GetElementNormalCount(),
+				[pFbxMesh](int i) { return pFbxMesh->GetElementNormal(i); }, pTriangles);
+			describeLayerElements(sources, pFbxMesh, "tangents", pFbxMesh->GetElementTangentCount(),
+				[pFbxMesh](int i) { return pFbxMesh->GetElementTangent(i); }, pTriangles);
+			describeLayerElements(sources, pFbxMesh, "binormals", pFbxMesh->GetElementBinormalCount(),
+				[pFbxMesh](int i) { return pFbxMesh->GetElementBinormal(i); }, pTriangles);
+			describeLayerElements(sources, pFbxMesh, "smoothing", pFbxMesh->GetElementSmoothingCount(),
+				[pFbxMesh](int i) { return pFbxMesh->GetElementSmoothing(i); }, pTriangles);
+			int kept = 0;
+			for (int i = 0; i < pFbxMesh->GetElementMaterialCount(); i++) {
+				FbxGeometryElementMaterial *elem = pFbxMesh->GetElementMaterial(i);
+				if (pTriangles && !remapFits(pFbxMesh, elem, elem->GetIndexArray().GetCount()))
+					continue;
+				describeLayerArray(sources, "materials/" + std::to_string(kept++) + "/indexArray", elem->GetIndexArray(),
+					followsTriangles(elem) ? pTriangles : nullptr, elem);
 			}
-			break;
-		case FbxGeometryElement::eByPolygonVertex:
-		{
-			switch (leVtxc->GetReferenceMode())
-			{
-			case FbxGeometryElement::eDirect:
-			{
-				out = leVtxc->GetDirectArray().GetAt(vertexId);
-				return true;
+		}
+	}
+
+	// index and direct array of every element as exportLayerElements writes
+	// them, leaving out the same elements
+	template<class TGetElement>
+	static void describeLayerElements(MeshSources &sources, FbxMesh *pFbxMesh, const char *key, int count, TGetElement getElement,
+		const ArraySource *pTriangles)
+	{
+		int kept = 0;
+		for (int i = 0; i < count; i++) {
+			auto *elem = getElement(i);
+			bool direct = elem->GetReferenceMode() == FbxLayerElement::eDirect;
+			if (pTriangles && !remapFits(pFbxMesh, elem, direct ? elem->GetDirectArray().GetCount() : elem->GetIndexArray().GetCount()))
+				continue;
+			bool remapped = pTriangles && followsTriangles(elem);
+			std::string path = std::string(key) + "/" + std::to_string(kept++) + "/";
+			describeLayerArray(sources, path + "indexArray", elem->GetIndexArray(), remapped && !direct ? pTriangles : nullptr, elem);
+			describeLayerArray(sources, path + "directArray", elem->GetDirectArray(), remapped && direct ? pTriangles : nullptr, elem);
+		}
+	}
+
+	// `pTriangles` when the array is remapped to triangles
+	template<class T>
+	static void describeLayerArray(MeshSources &sources, const std::string &path, const FbxLayerElementArrayTemplate<T> &array,
+		const ArraySource *pTriangles, FbxLayerElement *elem)
+	{
+		std::string transform = std::is_same<typename LayerArrayTraits<T>::Component, int>::value ? "ints" :
+			"doubles/" + std::to_string(LayerArrayTraits<T>::components);
+		std::pair<const void*, size_t> values = sources.lock(array);
+		if (pTriangles)
+			transform += "/" + MappingModeEnumString(elem->GetMappingMode());
+		ArraySource &source = sources.add(path, transform, values.second).block(values.first, values.second);
+		if (pTriangles)
+			source.blocks.insert(source.blocks.end(), pTriangles->blocks.begin(), pTriangles->blocks.end());
+	}
+
+	// {"attributes": [{"name", "components"}...], "polygonVertexCount": n,
+	//  "vertexCount": n, "vertices" or "streams": ..., "indices": [...]}
+	static int exportVertexBuffer(SceneWriter &w, FbxMesh *pFbxMesh, const ExportOptions &options, const Triangulation *pTriangles)
+	{
+		TraceScope trace("layer", "vertexBuffer");
+		VertexBuffer buffer;
+		VertexWelder::build(pFbxMesh, buffer);
+		// welded per source polygon vertex, so triangles only pick indices
+		if (pTriangles && !buffer.indices.empty()) {
+			std::vector<int> indices;
+			indices.reserve(pTriangles->corners.size());
+			for (int corner : pTriangles->corners)
+				indices.push_back(buffer.indices[corner]);
+			buffer.indices.swap(indices);
+		}
+		w.key("vertexBuffer");
+		w.startObject(5);
+		w.key("attributes");
+		w.startArray(buffer.attributes.size());
+		for (const VertexBuffer::Attribute &attribute : buffer.attributes) {
+			w.startObject(2);
+			w.key("name");
+			w.string(attribute.name);
+			w.key("components");
+			w.numberInteger(attribute.components);
+			w.endObject();
+		}
+		w.endArray();
+		w.key("polygonVertexCount");
+		w.numberInteger(pTriangles ? static_cast<int64_t>(pTriangles->corners.size()) : pFbxMesh->GetPolygonVertexCount());
+		w.key("vertexCount");
+		w.numberInteger(buffer.vertexCount());
+		if (options.vertexBuffer == ExportOptions::eInterleavedVertices) {
+			w.key("vertices");
+			w.floatArray(buffer.vertices.data(), buffer.vertexCount(), std::max(1, buffer.stride));
+		}
+		else {
+			w.key("streams");
+			w.startObject(buffer.attributes.size());
+			for (size_t a = 0; a < buffer.attributes.size(); a++) {
+				std::vector<double> values = buffer.stride ? buffer.stream(a) : std::vector<double>();
+				w.key(buffer.attributes[a].name);
+				w.floatArray(values.data(), buffer.vertexCount(), buffer.attributes[a].components);
 			}
-			case FbxGeometryElement::eIndexToDirect:
+			w.endObject();
+		}
+		w.key("indices");
+		w.intArray(buffer.indices.data(), buffer.indices.size());
+		w.endObject();
+		return buffer.vertexCount();
+	}
+
+	struct ExportState
+	{
+		ExportState(const ExportOptions &o, FbxNode *root) : options(o)
+		{
+			if (!o.filter.empty())
+				selection.reset(new NodeSelection(root, o.filter));
+		}
+		const ExportOptions &options;
+		// nodes to write, everything when null
+		std::unique_ptr<NodeSelection> selection;
+		// meshes serialized ahead on other threads
+		MeshExportQueue *meshQueue = nullptr;
+		// mesh table indices, meshes are written inline when null
+		const std::unordered_map<FbxMesh*, int64_t> *meshIndex = nullptr;
+		// replaces shared arrays with references when set
+		ArrayDedup *dedup = nullptr;
+		// the export's thread pool, also used to triangulate large meshes
+		ThreadPool *pool = nullptr;
+
+		bool contains(FbxNode *node) const { return !selection || selection->contains(node); }
+		// the node's own mesh, null for structural nodes kept for their children
+		FbxMesh *meshOf(FbxNode *node) const
+		{
+			return !selection || selection->selected(node) ? node->GetMesh() : nullptr;
+		}
+		int childCount(FbxNode *node) const
+		{
+			return selection ? selection->childCount(node) : node->GetChildCount();
+		}
+	};
+
+	static void exportNode(SceneWriter &w, FbxNode *node, const ExportState &state)
+	{
+		TraceScope trace("export", "exportNode", node->GetName());
+		FbxMesh *pMesh = state.meshOf(node);
+		w.startObject(3);
+		w.key("name");
+		w.string(node->GetName());
+		w.key("mesh");
+		if (state.meshIndex && pMesh)
+			w.numberInteger(state.meshIndex->at(pMesh));
+		else if (state.meshQueue && pMesh)
+			state.meshQueue->writeNext(w);
+		else
+			exportMeshObject(w, pMesh, state, false);
+		w.key("children");
+		w.startArray(state.childCount(node));
+		for (int i = 0; i < node->GetChildCount(); i++)
+		{
+			if (state.contains(node->GetChild(i)))
+				exportNode(w, node->GetChild(i), state);
+		}
+		w.endArray();
+		w.endObject();
+	}
+
+	// the node and its subtree, meshes are serialized on a thread pool ahead
+	// of the walk unless there is a single thread or they are in a table
+	static void exportTree(SceneWriter &w, FbxNode *node, ExportState &state)
+	{
+		if (state.options.threads == 1 || state.meshIndex)
+		{
+			exportNode(w, node, state);
+			return;
+		}
+		std::vector<FbxMesh*> meshes;
+		collectMeshes(node, state, meshes);
+		ThreadPool pool(state.options.threads);
+		state.pool = &pool;
+		{
+			MeshExportQueue queue(w, pool, meshes, [&state](SceneWriter &fragment, FbxMesh *mesh) {
+				exportMeshObject(fragment, mesh, state, false);
+			});
+			state.meshQueue = &queue;
+			exportNode(w, node, state);
+		}
+		state.meshQueue = nullptr;
+		state.pool = nullptr;
+	}
+
+	// every distinct mesh once, in the order the walk first reaches them
+	static void exportMeshTable(SceneWriter &w, const std::vector<FbxMesh*> &table, ExportState &state)
+	{
+		w.startArray(table.size());
+		if (state.options.threads == 1)
+		{
+			for (FbxMesh *pMesh : table)
+				exportMeshObject(w, pMesh, state, true);
+		}
+		else
+		{
+			ThreadPool pool(state.options.threads);
+			state.pool = &pool;
 			{
-				int id = leVtxc->GetIndexArray().GetAt(vertexId);
-				out = leVtxc->GetDirectArray().GetAt(id);
-				return true;
-			}
-			break;
-			default:
-				break; // other reference modes not shown here!
+				MeshExportQueue queue(w, pool, table, [&state](SceneWriter &fragment, FbxMesh *mesh) {
+					exportMeshObject(fragment, mesh, state, true);
+				});
+				for (size_t i = 0; i < table.size(); i++)
+					queue.writeNext(w);
 			}
+			state.pool = nullptr;
 		}
-		case FbxGeometryElement::eByPolygon: // doesn't make much sense for UVs
-		case FbxGeometryElement::eAllSame:   // doesn't make much sense for UVs
-		case FbxGeometryElement::eNone:       // doesn't make much sense for UVs
-			break;
-		default:
-			break;
+		w.endArray();
+	}
+
+	static void exportMeshObject(SceneWriter &w, FbxMesh *pFbxMesh, const ExportState &state, bool withId)
+	{
+		if (state.dedup && pFbxMesh) {
+			ArrayDedup::MeshWriter dedupWriter(w, *state.dedup, pFbxMesh);
+			exportMeshObject(dedupWriter, pFbxMesh, state.options, withId, state.pool);
+			return;
 		}
-		return false;
+		exportMeshObject(w, pFbxMesh, state.options, withId, state.pool);
 	}
 
-	static json dumpColor(const FbxColor& color) {
-		return json({ color.mRed, color.mGreen, color.mBlue, color.mAlpha });
+	// {"strings": [...], "name", "parent", "firstChild", "nextSibling",
+	// "childCount", "mesh": [...]}, one entry per node in each array and a
+	// mesh table index or -1 in "mesh"
+	static void exportNodeTable(SceneWriter &w, const NodeTable &nodes, const std::unordered_map<FbxMesh*, int64_t> &meshIndex)
+	{
+		TraceScope trace("export", "exportNodeTable");
+		std::vector<int> meshes;
+		meshes.reserve(nodes.size());
+		for (FbxMesh *pMesh : nodes.meshes)
+			meshes.push_back(pMesh ? static_cast<int>(meshIndex.at(pMesh)) : -1);
+		w.startObject(7);
+		w.key("strings");
+		w.startArray(nodes.strings.size());
+		for (const std::string &name : nodes.strings)
+			w.string(name);
+		w.endArray();
+		w.key("name");
+		w.intArray(nodes.name.data(), nodes.name.size());
+		w.key("parent");
+		w.intArray(nodes.parent.data(), nodes.parent.size());
+		w.key("firstChild");
+		w.intArray(nodes.firstChild.data(), nodes.firstChild.size());
+		w.key("nextSibling");
+		w.intArray(nodes.nextSibling.data(), nodes.nextSibling.size());
+		w.key("childCount");
+		w.intArray(nodes.childCount.data(), nodes.childCount.size());
+		w.key("mesh");
+		w.intArray(meshes.data(), meshes.size());
+		w.endObject();
 	}
-	static json dumpVector4(const FbxVector4& v) {
-		return json({v[0], v[1], v[2], v[3]});
+
+	// meshes in the order exportNode reaches them
+	static void collectMeshes(FbxNode *node, const ExportState &state, std::vector<FbxMesh*> &meshes)
+	{
+		if (FbxMesh *pMesh = state.meshOf(node))
+			meshes.push_back(pMesh);
+		for (int i = 0; i < node->GetChildCount(); i++)
+		{
+			if (state.contains(node->GetChild(i)))
+				collectMeshes(node->GetChild(i), state, meshes);
+		}
 	}
 
-	static json exportMesh(FbxMesh *pFbxMesh)
+	// last vertex of each polygon stored as ~index
+	static void exportNestedPolygons(SceneWriter &w, FbxMesh *pFbxMesh)
 	{
-		if (pFbxMesh == nullptr) {
-			return json(nullptr);
+		TraceScope trace("layer", "polygons");
+		const int *pVertices = pFbxMesh->GetPolygonVertices();
+		std::vector<int> polygons(pVertices, pVertices + pFbxMesh->GetPolygonVertexCount());
+		for (int i = 0; i < pFbxMesh->GetPolygonCount(); i++) {
+			int lLast = pFbxMesh->GetPolygonVertexIndex(i) + pFbxMesh->GetPolygonSize(i) - 1;
+			polygons[lLast] = ~polygons[lLast];
 		}
+		w.key("polygons");
+		w.polygonArray(polygons.data(), polygons.size(), pFbxMesh->GetPolygonCount());
+	}
 
-		json ret = {};
-		ret["name"] = pFbxMesh->GetName();
+	// polygon corners as one flat array, zero-copy from the mesh
+	static void exportCsrPolygons(SceneWriter &w, FbxMesh *pFbxMesh)
+	{
+		TraceScope trace("layer", "polygons");
+		int nPolygonCount = pFbxMesh->GetPolygonCount();
+		w.key("polygonVertexIndices");
+		w.intArray(pFbxMesh->GetPolygonVertices(), pFbxMesh->GetPolygonVertexCount());
 
-		//control points
-		FbxVector4* lControlPoints = pFbxMesh->GetControlPoints();
-		int nPtCount = pFbxMesh->GetControlPointsCount();
-		std::vector<json> data;
-		data.reserve(nPtCount);
-		for (int i = 0; i < nPtCount; ++i) {
-			const auto& c = pFbxMesh->GetControlPointAt(i);
-			data.push_back(json({ c[0],c[1],c[2],c[3] }));
+		int lUniformSize = nPolygonCount > 0 ? pFbxMesh->GetPolygonSize(0) : -1;
+		for (int i = 1; i < nPolygonCount && lUniformSize >= 0; i++) {
+			if (pFbxMesh->GetPolygonSize(i) != lUniformSize)
+				lUniformSize = -1;
+		}
+		if (lUniformSize >= 0) {
+			w.key("polygonSize");
+			w.numberInteger(lUniformSize);
+			return;
 		}
-		ret["controlPoints"] = data;
 
-		//ploygons
-		std::vector<json> polygons;
-		int vertexId = 0;
-		for (int i = 0; i < pFbxMesh->GetPolygonCount(); i++) {
-			int lPolygonSize = pFbxMesh->GetPolygonSize(i);
-			std::vector<int> pointIndex;
-			for(int j=0;j<lPolygonSize;j++){
-				int lControlPointIndex = pFbxMesh->GetPolygonVertex(i, j);
-				pointIndex.push_back(lControlPointIndex);
+		std::vector<int> offsets;
+		offsets.reserve(nPolygonCount + 1);
+		offsets.push_back(0);
+		for (int i = 0; i < nPolygonCount; i++) {
+			offsets.push_back(offsets.back() + pFbxMesh->GetPolygonSize(i));
+		}
+		w.key("polygonOffsets");
+		w.intArray(offsets.data(), offsets.size());
+	}
+
+	// triangles as either polygons layout; CSR always has a polygonSize of 3
+	static void exportTriangles(SceneWriter &w, FbxMesh *pFbxMesh, const Triangulation &triangles, bool csr)
+	{
+		TraceScope trace("layer", "polygons");
+		const int *pVertices = pFbxMesh->GetPolygonVertices();
+		std::vector<int> vertices;
+		vertices.reserve(triangles.corners.size());
+		for (int corner : triangles.corners)
+			vertices.push_back(pVertices[corner]);
+		if (csr) {
+			w.key("polygonVertexIndices");
+			w.intArray(vertices.data(), vertices.size());
+			if (vertices.empty()) {
+				int lOffset = 0;
+				w.key("polygonOffsets");
+				w.intArray(&lOffset, 1);
+				return;
 			}
-			polygons.push_back(json(pointIndex));
-		}
-		ret["polygons"] = polygons;
-
-		//vertex colors
-		std::vector<json> vcData = {};
-		int clrChannelCnt = pFbxMesh->GetElementVertexColorCount();
-		for (int i = 0; i < clrChannelCnt; i++) {
-			json j = {};
-			FbxGeometryElementVertexColor *clrElem = pFbxMesh->GetElementVertexColor(i);
-			j["name"] = clrElem->GetName();
-			j["mappingMode"] = MappingModeEnumString(clrElem->GetMappingMode());
-			j["refMode"] = ReferenceModeString(clrElem->GetReferenceMode());
-			auto& dirArray = clrElem->GetDirectArray();
-			auto& indexArray = clrElem->GetIndexArray();
-			j["indexArray"] = dumpIndexArray(indexArray);
-			j["directArray"] = dumpColorArray(dirArray);
-			vcData.push_back(j);
-		}
-		ret["vertexColors"] = json(vcData);
-		
-		//element uvs
-		int uvChannelCnt = pFbxMesh->GetElementUVCount();
-		std::vector<json> uvData = {};
-		for (int uvi = 0; uvi < uvChannelCnt; ++uvi)
-		{
-			json j = {};
-			FbxGeometryElementUV* pElementUV = pFbxMesh->GetElementUV(uvi);
-			auto mappingMode = pElementUV->GetMappingMode();
-			auto refMode = pElementUV->GetReferenceMode();
-			auto& directArray = pElementUV->GetDirectArray();
-			auto& idxArray = pElementUV->GetIndexArray();
-
-			j["name"] = pElementUV->GetName();
-			j["mappingMode"] = MappingModeEnumString(mappingMode);
-			j["refMode"] = ReferenceModeString(refMode);
-			j["indexArray"] = dumpIndexArray(idxArray);
-			j["directArray"] = dumpVector2Array(directArray);
-			uvData.push_back(j);
-		}
-		ret["uv"] = json(uvData);
-		return ret;
+			w.key("polygonSize");
+			w.numberInteger(3);
+			return;
+		}
+		for (size_t i = 2; i < vertices.size(); i += 3)
+			vertices[i] = ~vertices[i];
+		w.key("polygons");
+		w.polygonArray(vertices.data(), vertices.size(), triangles.triangleCount());
 	}
-};
 
+	static void exportPointAdjacency(SceneWriter &w, FbxMesh *pFbxMesh, const Triangulation *pTriangles)
+	{
+		TraceScope trace("layer", "pointAdjacency");
+		PointAdjacency adjacency;
+		if (pTriangles) {
+			const int *pVertices = pFbxMesh->GetPolygonVertices();
+			std::vector<int> vertices;
+			vertices.reserve(pTriangles->corners.size());
+			for (int corner : pTriangles->corners)
+				vertices.push_back(pVertices[corner]);
+			PointAdjacency::build(vertices.data(), static_cast<int>(vertices.size()), pFbxMesh->GetControlPointsCount(), adjacency);
+		}
+		else {
+			PointAdjacency::build(pFbxMesh, adjacency);
+		}
+		w.key("pointAdjacency");
+		w.startObject(2);
+		w.key("offsets");
+		w.intArray(adjacency.offsets.data(), adjacency.offsets.size());
+		w.key("polygonVertices");
+		w.intArray(adjacency.polygonVertices.data(), adjacency.polygonVertices.size());
+		w.endObject();
+	}
+
+	// one {name, mappingMode, refMode, indexArray, directArray} entry per
+	// element, the arrays as stored rather than expanded by
+	// LayerElementResolver; triangulated meshes leave out the elements
+	// remapFits rejects
+	template<class TGetElement>
+	static void exportLayerElements(SceneWriter &w, FbxMesh *pFbxMesh, const char *key, int count, TGetElement getElement,
+		const Triangulation *pTriangles)
+	{
+		std::vector<decltype(getElement(0))> elements;
+		for (int i = 0; i < count; i++) {
+			auto *elem = getElement(i);
+			bool direct = elem->GetReferenceMode() == FbxLayerElement::eDirect;
+			if (!pTriangles || remapFits(pFbxMesh, elem, direct ? elem->GetDirectArray().GetCount() : elem->GetIndexArray().GetCount(), key))
+				elements.push_back(elem);
+		}
+		w.key(key);
+		w.startArray(elements.size());
+		for (auto *elem : elements) {
+			TraceScope trace("layer", key, elem->GetName());
+			const std::vector<int> *remap = triangulatedSource(elem, pTriangles);
+			bool direct = elem->GetReferenceMode() == FbxLayerElement::eDirect;
+			w.startObject(5);
+			exportLayerElementHeader(w, elem);
+			w.key("indexArray");
+			dumpLayerArray(w, elem->GetIndexArray(), direct ? nullptr : remap);
+			w.key("directArray");
+			dumpLayerArray(w, elem->GetDirectArray(), direct ? remap : nullptr);
+			w.endObject();
+		}
+		w.endArray();
+	}
+
+	// material elements only index into the node's materials, they have no direct array
+	static void exportMaterialElements(SceneWriter &w, FbxMesh *pFbxMesh, const Triangulation *pTriangles)
+	{
+		std::vector<FbxGeometryElementMaterial*> elements;
+		for (int i = 0; i < pFbxMesh->GetElementMaterialCount(); i++) {
+			FbxGeometryElementMaterial *elem = pFbxMesh->GetElementMaterial(i);
+			if (!pTriangles || remapFits(pFbxMesh, elem, elem->GetIndexArray().GetCount(), "materials"))
+				elements.push_back(elem);
+		}
+		w.key("materials");
+		w.startArray(elements.size());
+		for (FbxGeometryElementMaterial *elem : elements) {
+			TraceScope trace("layer", "materials", elem->GetName());
+			w.startObject(4);
+			exportLayerElementHeader(w, elem);
+			w.key("indexArray");
+			dumpLayerArray(w, elem->GetIndexArray(), triangulatedSource(elem, pTriangles));
+			w.endObject();
+		}
+		w.endArray();
+	}
+
+	static void writeComponents(SceneWriter &w, const int *data, int count, int components)
+	{
+		w.intArray(data, count, components);
+	}
+	static void writeComponents(SceneWriter &w, const double *data, int count, int components)
+	{
+		w.floatArray(data, count, components);
+	}
+
+	static void exportLayerElementHeader(SceneWriter &w, FbxLayerElement *elem)
+	{
+		w.key("name");
+		w.string(elem->GetName());
+		w.key("mappingMode");
+		w.string(MappingModeEnumString(elem->GetMappingMode()));
+		w.key("refMode");
+		w.string(ReferenceModeString(elem->GetReferenceMode()));
+	}
+};
@@ -18,7 +18,7 @@
 	#define IOS_REF (*(pManager->GetIOSettings()))
 #endif
 
-void InitializeSdkObjects(FbxManager*& pManager, FbxScene*& pScene)
+void InitializeSdkManager(FbxManager*& pManager)
 {
     //The first thing to do is to create the FBX Manager which is the object allocator for almost all the classes in the SDK
     pManager = FbxManager::Create();
@@ -37,6 +37,11 @@ void InitializeSdkObjects(FbxManager*& pManager, FbxScene*& pScene)
 	FbxString lPath = FbxGetApplicationDirectory();
 	// Cannot load plug-in since it may introduce CRT conflicts.
 	//pManager->LoadPluginsDirectory(lPath.Buffer());
+}
+
+void InitializeSdkObjects(FbxManager*& pManager, FbxScene*& pScene)
+{
+    InitializeSdkManager(pManager);
 
     //Create an FBX scene. This object holds most objects imported/exported from/to files.
     pScene = FbxScene::Create(pManager, "My Scene");
@@ -139,7 +144,37 @@ bool SaveScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename,
     return lStatus;
 }
 
-bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename, int& fileVersion)
+bool ParseImportProfile(const char* pName, ImportProfile& pProfile)
+{
+    FbxString lName(pName);
+    if (lName == "full") pProfile = eImportFull;
+    else if (lName == "rig") pProfile = eImportRig;
+    else if (lName == "geometry") pProfile = eImportGeometry;
+    else return false;
+    return true;
+}
+
+bool CheckSceneIntegrity(FbxScene* pScene)
+{
+    FbxStatus status;
+    FbxArray< FbxString*> details;
+    FbxSceneCheckUtility sceneCheck(pScene, &status, &details);
+    bool lStatus = sceneCheck.Validate(FbxSceneCheckUtility::eCkeckData);
+    if (lStatus == false)
+    {
+        if (details.GetCount())
+        {
+            FBXSDK_printf("Scene integrity verification failed with the following errors:\n");
+            for (int i = 0; i < details.GetCount(); i++)
+                FBXSDK_printf("   %s\n", details[i]->Buffer());
+
+            FbxArrayDelete<FbxString*>(details);
+        }
+    }
+    return lStatus;
+}
+
+bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename, int& fileVersion, ImportProfile pProfile, bool pCheckScene)
 {
     int lFileMajor, lFileMinor, lFileRevision;
     int lSDKMajor,  lSDKMinor,  lSDKRevision;
@@ -211,36 +246,27 @@ bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename,
         }
 
         // Set the import states. By default, the import states are always set to 
-        // true. The code below shows how to change these states.
+        // true. Reduced profiles skip what the caller will not read; the settings
+        // belong to the manager, so every state is set on each load.
+        bool lFull = pProfile == eImportFull;
+        bool lRig = pProfile != eImportGeometry;
         IOS_REF.SetBoolProp(IMP_FBX_MATERIAL,        true);
-        IOS_REF.SetBoolProp(IMP_FBX_TEXTURE,         true);
-        IOS_REF.SetBoolProp(IMP_FBX_LINK,            true);
-        IOS_REF.SetBoolProp(IMP_FBX_SHAPE,           true);
-        IOS_REF.SetBoolProp(IMP_FBX_GOBO,            true);
-        IOS_REF.SetBoolProp(IMP_FBX_ANIMATION,       true);
+        IOS_REF.SetBoolProp(IMP_FBX_TEXTURE,         lFull);
+        IOS_REF.SetBoolProp(IMP_FBX_LINK,            lRig);
+        IOS_REF.SetBoolProp(IMP_FBX_SHAPE,           lRig);
+        IOS_REF.SetBoolProp(IMP_FBX_CHARACTER,       lRig);
+        IOS_REF.SetBoolProp(IMP_FBX_CONSTRAINT,      lRig);
+        IOS_REF.SetBoolProp(IMP_FBX_GOBO,            lFull);
+        IOS_REF.SetBoolProp(IMP_FBX_ANIMATION,       lFull);
         IOS_REF.SetBoolProp(IMP_FBX_GLOBAL_SETTINGS, true);
     }
 
     // Import the scene.
     lStatus = lImporter->Import(pScene);
-	if (lStatus == true)
+	if (lStatus == true && pCheckScene)
 	{
 		// Check the scene integrity!
-		FbxStatus status;
-		FbxArray< FbxString*> details;
-		FbxSceneCheckUtility sceneCheck(FbxCast<FbxScene>(pScene), &status, &details);
-		lStatus = sceneCheck.Validate(FbxSceneCheckUtility::eCkeckData);
-		if (lStatus == false)
-		{
-			if (details.GetCount())
-			{
-				FBXSDK_printf("Scene integrity verification failed with the following errors:\n");
-				for (int i = 0; i < details.GetCount(); i++)
-					FBXSDK_printf("   %s\n", details[i]->Buffer());
-
-				FbxArrayDelete<FbxString*>(details);
-			}
-		}
+		lStatus = CheckSceneIntegrity(FbxCast<FbxScene>(pScene));
 	}
 
     if(lStatus == false && lImporter->GetStatus().GetCode() == FbxStatus::ePasswordError)
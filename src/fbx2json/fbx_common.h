@@ -11,11 +11,24 @@
 #pragma once
 #include <fbxsdk.h>
 
+void InitializeSdkManager(FbxManager*& pManager);
 void InitializeSdkObjects(FbxManager*& pManager, FbxScene*& pScene);
 void DestroySdkObjects(FbxManager* pManager, bool pExitStatus);
 
 bool SaveScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename, int fileVersion, int pFileFormat=-1, bool pEmbedMedia=false);
-bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename, int& fileVersion);
+// Which parts of an FBX file LoadScene imports.
+enum ImportProfile
+{
+    eImportFull,     // everything, the SDK default
+    eImportRig,      // geometry plus skin links, blend shapes, characters and constraints
+    eImportGeometry, // nodes, meshes, layer elements and materials only
+};
+bool ParseImportProfile(const char* pName, ImportProfile& pProfile);
+
+// pCheckScene runs CheckSceneIntegrity on the imported scene.
+bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename, int& fileVersion, ImportProfile pProfile=eImportFull, bool pCheckScene=true);
+// FbxSceneCheckUtility data check, printing what it finds.
+bool CheckSceneIntegrity(FbxScene* pScene);
 
 // to get a string from the node name and attribute type
 FbxString GetNodeNameAndAttributeTypeName(const FbxNode *pNode);
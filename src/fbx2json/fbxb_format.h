@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+
+// On-disk layout of .fbxb scenes, shared by FbxbWriter and FbxbReader. A file
+// is little-endian, starts with an FbxbHeader and keeps every table and array
+// at a multiple of fbxbAlignment, so a mapped file is read in place:
+//   header | mesh arrays ... | nodes | meshes | array directory | strings
+// Nodes form a preorder table like the one --node-table writes. Each mesh
+// owns a contiguous run of directory entries, each entry locates one typed
+// array. Names are offsets into the string blob and are NUL-terminated.
+
+static const char fbxbMagic[4] = {'F', 'B', 'X', 'B'};
+static const uint32_t fbxbVersion = 1;
+static const uint64_t fbxbAlignment = 64;
+
+struct FbxbHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t nodeCount;
+	uint32_t meshCount;
+	uint32_t arrayCount;
+	uint32_t stringBytes;
+	// byte offsets of the FbxbNode, FbxbMesh and FbxbArray tables and of
+	// the string blob
+	uint64_t nodesOffset;
+	uint64_t meshesOffset;
+	uint64_t arraysOffset;
+	uint64_t stringsOffset;
+	uint64_t fileSize;
+};
+
+// node 0 is the root; indices are -1 where there is no such node or mesh
+struct FbxbNode
+{
+	uint32_t name;
+	uint32_t nameLength;
+	int32_t parent;
+	int32_t firstChild;
+	int32_t nextSibling;
+	int32_t childCount;
+	int32_t mesh;
+	uint32_t reserved;
+};
+
+struct FbxbMesh
+{
+	// the FBX unique ID
+	uint64_t id;
+	uint32_t name;
+	uint32_t nameLength;
+	uint32_t controlPointCount;
+	// triangles and 3 * triangles when the scene was triangulated
+	uint32_t polygonCount;
+	uint32_t polygonVertexCount;
+	// directory entries [firstArray, firstArray + arrayCount)
+	uint32_t firstArray;
+	uint32_t arrayCount;
+	uint32_t reserved;
+};
+
+struct FbxbArray
+{
+	enum Semantic : uint16_t
+	{
+		// per control point, x y z
+		ePositions,
+		// per polygon vertex, its control point
+		ePolygonVertices,
+		// polygonCount + 1 starts into the polygon vertices
+		ePolygonOffsets,
+		// per polygon vertex, x y z
+		eNormals,
+		// per polygon vertex, u v
+		eUVs,
+		// per polygon vertex, r g b a
+		eColors,
+	};
+	enum ComponentType : uint16_t
+	{
+		eInt32,
+		eFloat32,
+		eFloat64,
+	};
+
+	uint64_t offset;
+	// tuples of `components` values
+	uint64_t count;
+	uint64_t byteLength;
+	uint16_t semantic;
+	// layer element index for normals, UVs and colors
+	uint16_t set;
+	uint16_t componentType;
+	uint16_t components;
+};
+
+static_assert(sizeof(FbxbHeader) == 64, "FbxbHeader is 64 bytes on disk");
+static_assert(sizeof(FbxbNode) == 32, "FbxbNode is 32 bytes on disk");
+static_assert(sizeof(FbxbMesh) == 40, "FbxbMesh is 40 bytes on disk");
+static_assert(sizeof(FbxbArray) == 32, "FbxbArray is 32 bytes on disk");
+
+inline uint64_t FbxbComponentSize(uint16_t componentType)
+{
+	return componentType == FbxbArray::eFloat64 ? 8 : 4;
+}
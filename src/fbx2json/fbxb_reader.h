@@ -0,0 +1,256 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "./fbxb_format.h"
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Reading side of .fbxb scenes. Header-only and C++14 with no dependency on
+// the FBX SDK, so other tools can copy it together with fbxb_format.h.
+//   FbxbMappedFile file;
+//   FbxbReader scene;
+//   if (file.open("scene.fbxb") && scene.open(file.data(), file.size()))
+//       FbxbView<double> uvs = scene.values<double>(scene.find(scene.meshes()[17], FbxbArray::eUVs));
+// Floats are doubles unless the file was written with --float32, which needs
+// values<float>; the component type of the wrong width gives an empty view.
+// Only the pages of the tables and of the arrays that are touched get read.
+
+// `size()` values of T inside a buffer that outlives the view
+template <class T>
+class FbxbView
+{
+public:
+	FbxbView() : mData(nullptr), mSize(0) {}
+	FbxbView(const T *data, size_t size) : mData(data), mSize(size) {}
+
+	const T *data() const { return mData; }
+	size_t size() const { return mSize; }
+	bool empty() const { return mSize == 0; }
+	const T &operator[](size_t i) const { return mData[i]; }
+	const T *begin() const { return mData; }
+	const T *end() const { return mData + mSize; }
+
+private:
+	const T *mData;
+	size_t mSize;
+};
+
+template <class T>
+struct FbxbComponentTraits;
+template <>
+struct FbxbComponentTraits<int32_t>
+{
+	static const uint16_t type = FbxbArray::eInt32;
+};
+template <>
+struct FbxbComponentTraits<float>
+{
+	static const uint16_t type = FbxbArray::eFloat32;
+};
+template <>
+struct FbxbComponentTraits<double>
+{
+	static const uint16_t type = FbxbArray::eFloat64;
+};
+
+// Views into a .fbxb scene held in memory, normally a mapped file. open()
+// checks the header, every table and every directory entry against the
+// buffer once, so the views it hands out afterwards need no checks and copy
+// nothing.
+class FbxbReader
+{
+public:
+	FbxbReader() : mData(nullptr), mHeader(nullptr) {}
+
+	// false with `error` set when the buffer is not a .fbxb scene of this
+	// version, or the host is not little-endian
+	bool open(const void *data, size_t size, std::string *error = nullptr)
+	{
+		mData = static_cast<const char *>(data);
+		mHeader = nullptr;
+		const char *problem = check(size);
+		if (problem == nullptr)
+			return true;
+		mHeader = nullptr;
+		if (error)
+			*error = problem;
+		return false;
+	}
+
+	const FbxbHeader &header() const { return *mHeader; }
+	FbxbView<FbxbNode> nodes() const { return table<FbxbNode>(mHeader->nodesOffset, mHeader->nodeCount); }
+	FbxbView<FbxbMesh> meshes() const { return table<FbxbMesh>(mHeader->meshesOffset, mHeader->meshCount); }
+	// the directory entries of one mesh
+	FbxbView<FbxbArray> arrays(const FbxbMesh &mesh) const
+	{
+		return FbxbView<FbxbArray>(directory().data() + mesh.firstArray, mesh.arrayCount);
+	}
+	// NUL-terminated
+	const char *name(const FbxbNode &node) const { return mData + mHeader->stringsOffset + node.name; }
+	const char *name(const FbxbMesh &mesh) const { return mData + mHeader->stringsOffset + mesh.name; }
+
+	// the array of `semantic` and layer element `set`, null when the mesh has none
+	const FbxbArray *find(const FbxbMesh &mesh, FbxbArray::Semantic semantic, int set = 0) const
+	{
+		for (const FbxbArray &array : arrays(mesh))
+		{
+			if (array.semantic == semantic && array.set == set)
+				return &array;
+		}
+		return nullptr;
+	}
+	// count * components values, empty when `array` is null or T is not its
+	// component type (int32_t, float or double)
+	template <class T>
+	FbxbView<T> values(const FbxbArray *array) const
+	{
+		if (array == nullptr || array->componentType != FbxbComponentTraits<T>::type)
+			return FbxbView<T>();
+		return FbxbView<T>(reinterpret_cast<const T *>(mData + array->offset), static_cast<size_t>(array->count) * array->components);
+	}
+
+private:
+	template <class T>
+	FbxbView<T> table(uint64_t offset, uint32_t count) const
+	{
+		return FbxbView<T>(reinterpret_cast<const T *>(mData + offset), count);
+	}
+	FbxbView<FbxbArray> directory() const { return table<FbxbArray>(mHeader->arraysOffset, mHeader->arrayCount); }
+
+	// the first problem found, null for a valid file
+	const char *check(size_t size)
+	{
+		const uint16_t probe = 1;
+		if (*reinterpret_cast<const uint8_t *>(&probe) != 1)
+			return "fbxb files can only be read on little-endian hosts";
+		if (mData == nullptr || size < sizeof(FbxbHeader) || reinterpret_cast<uintptr_t>(mData) % alignof(uint64_t) != 0)
+			return "Not an fbxb file";
+		const FbxbHeader *header = reinterpret_cast<const FbxbHeader *>(mData);
+		if (std::memcmp(header->magic, fbxbMagic, sizeof(fbxbMagic)) != 0)
+			return "Not an fbxb file";
+		if (header->version != fbxbVersion)
+			return "Unsupported fbxb version";
+		if (header->fileSize > size)
+			return "Truncated fbxb file";
+		if (!fits(header->nodesOffset, header->nodeCount, sizeof(FbxbNode), size) ||
+			!fits(header->meshesOffset, header->meshCount, sizeof(FbxbMesh), size) ||
+			!fits(header->arraysOffset, header->arrayCount, sizeof(FbxbArray), size) ||
+			!fits(header->stringsOffset, header->stringBytes, 1, size))
+			return "fbxb table outside the file";
+		mHeader = header;
+
+		const char *strings = mData + header->stringsOffset;
+		auto validName = [&](uint32_t name, uint32_t length) {
+			return name < header->stringBytes && length < header->stringBytes - name && strings[name + length] == '\0';
+		};
+		auto validNode = [&](int32_t node) { return node >= -1 && node < static_cast<int64_t>(header->nodeCount); };
+		for (const FbxbNode &node : nodes())
+		{
+			if (!validName(node.name, node.nameLength) || !validNode(node.parent) || !validNode(node.firstChild) ||
+				!validNode(node.nextSibling) || node.mesh < -1 || node.mesh >= static_cast<int64_t>(header->meshCount))
+				return "Invalid fbxb node";
+		}
+		for (const FbxbMesh &mesh : meshes())
+		{
+			if (!validName(mesh.name, mesh.nameLength) || mesh.firstArray > header->arrayCount ||
+				mesh.arrayCount > header->arrayCount - mesh.firstArray)
+				return "Invalid fbxb mesh";
+		}
+		for (const FbxbArray &array : directory())
+		{
+			if (array.componentType > FbxbArray::eFloat64 || array.components == 0 || array.offset % fbxbAlignment != 0)
+				return "Invalid fbxb array";
+			uint64_t tupleBytes = array.components * FbxbComponentSize(array.componentType);
+			if (!fits(array.offset, array.count, tupleBytes, size) || array.byteLength != array.count * tupleBytes)
+				return "fbxb array outside the file";
+		}
+		return nullptr;
+	}
+
+	// `count` items of `itemBytes` at `offset` lie inside the buffer, checked
+	// without overflowing
+	static bool fits(uint64_t offset, uint64_t count, uint64_t itemBytes, size_t size)
+	{
+		return offset <= size && count <= (size - offset) / itemBytes;
+	}
+
+	const char *mData;
+	const FbxbHeader *mHeader;
+};
+
+// A whole file mapped read-only; pages are read as they are touched.
+class FbxbMappedFile
+{
+public:
+	FbxbMappedFile() : mData(nullptr), mSize(0) {}
+	~FbxbMappedFile() { close(); }
+	FbxbMappedFile(const FbxbMappedFile &) = delete;
+	FbxbMappedFile &operator=(const FbxbMappedFile &) = delete;
+
+	bool open(const std::string &path)
+	{
+		close();
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		HANDLE mapping = nullptr;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (mapping == nullptr)
+			return false;
+		mData = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (mData == nullptr)
+			return false;
+		mSize = static_cast<size_t>(size.QuadPart);
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat info;
+		void *data = MAP_FAILED;
+		if (fstat(fd, &info) == 0 && info.st_size > 0)
+			data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (data == MAP_FAILED)
+			return false;
+		mData = data;
+		mSize = static_cast<size_t>(info.st_size);
+#endif
+		return true;
+	}
+
+	void close()
+	{
+		if (mData == nullptr)
+			return;
+#ifdef _WIN32
+		UnmapViewOfFile(mData);
+#else
+		munmap(mData, mSize);
+#endif
+		mData = nullptr;
+		mSize = 0;
+	}
+
+	const void *data() const { return mData; }
+	size_t size() const { return mSize; }
+
+private:
+	void *mData;
+	size_t mSize;
+};
@@ -0,0 +1,296 @@
+#pragma once
+#include <fbxsdk.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "./fbx2json.h"
+#include "./fbxb_format.h"
+
+// Writes a scene as .fbxb in one pass: mesh arrays are streamed as they are
+// built, the tables follow them and the header is then written over its
+// placeholder, so `file` has to be seekable. Polygons are always CSR and
+// layer elements are resolved to one value per polygon vertex, so every
+// per-vertex array shares the polygon vertex indices. Of the export options
+// the filter, triangulate, allLayers (adds normals), threads (triangulation)
+// and stats apply; float32 stores floats as 32 bit values.
+class FbxbWriter
+{
+public:
+	// returns the file size
+	static uint64_t write(std::ostream &file, FbxScene *pScene, const ExportOptions &options, bool float32 = false)
+	{
+		FbxNode *root = pScene->GetRootNode();
+		std::unique_ptr<NodeSelection> selection;
+		if (!options.filter.empty())
+			selection.reset(new NodeSelection(root, options.filter));
+		NodeTable nodes;
+		NodeTable::build(root, [&selection](FbxNode *node) { return !selection || selection->contains(node); },
+			[&selection](FbxNode *node) { return !selection || selection->selected(node) ? node->GetMesh() : nullptr; }, nodes);
+		std::unique_ptr<ThreadPool> pool;
+		if (options.triangulate && options.threads != 1)
+			pool.reset(new ThreadPool(options.threads));
+
+		OutputStream out(&file);
+		static const char placeholder[sizeof(FbxbHeader)] = {};
+		out.write(placeholder, sizeof(placeholder));
+		Strings strings;
+		std::vector<FbxbMesh> meshes;
+		std::vector<FbxbArray> arrays;
+		std::unordered_map<FbxMesh *, int> meshIndex;
+		std::vector<int> nodeMesh(nodes.size(), -1);
+		for (int i = 0; i < nodes.size(); i++)
+		{
+			FbxMesh *pMesh = nodes.meshes[i];
+			if (pMesh == nullptr)
+				continue;
+			auto inserted = meshIndex.emplace(pMesh, static_cast<int>(meshes.size()));
+			if (inserted.second)
+				meshes.push_back(writeMesh(out, pMesh, options, float32, pool.get(), strings, arrays));
+			nodeMesh[i] = inserted.first->second;
+		}
+
+		FbxbHeader header = {};
+		std::memcpy(header.magic, fbxbMagic, sizeof(fbxbMagic));
+		header.version = fbxbVersion;
+		header.nodeCount = nodes.size();
+		header.meshCount = static_cast<uint32_t>(meshes.size());
+		header.arrayCount = static_cast<uint32_t>(arrays.size());
+
+		header.nodesOffset = align(out);
+		for (int i = 0; i < nodes.size(); i++)
+		{
+			const std::string &name = nodes.strings[nodes.name[i]];
+			put<uint32_t>(out, strings.add(name));
+			put<uint32_t>(out, static_cast<uint32_t>(name.size()));
+			put<int32_t>(out, nodes.parent[i]);
+			put<int32_t>(out, nodes.firstChild[i]);
+			put<int32_t>(out, nodes.nextSibling[i]);
+			put<int32_t>(out, nodes.childCount[i]);
+			put<int32_t>(out, nodeMesh[i]);
+			put<uint32_t>(out, 0);
+		}
+		header.meshesOffset = align(out);
+		for (const FbxbMesh &mesh : meshes)
+		{
+			put(out, mesh.id);
+			put(out, mesh.name);
+			put(out, mesh.nameLength);
+			put(out, mesh.controlPointCount);
+			put(out, mesh.polygonCount);
+			put(out, mesh.polygonVertexCount);
+			put(out, mesh.firstArray);
+			put(out, mesh.arrayCount);
+			put(out, mesh.reserved);
+		}
+		header.arraysOffset = align(out);
+		for (const FbxbArray &array : arrays)
+		{
+			put(out, array.offset);
+			put(out, array.count);
+			put(out, array.byteLength);
+			put(out, array.semantic);
+			put(out, array.set);
+			put(out, array.componentType);
+			put(out, array.components);
+		}
+		header.stringsOffset = align(out);
+		header.stringBytes = static_cast<uint32_t>(strings.blob.size());
+		out.write(strings.blob);
+		header.fileSize = out.tell();
+		out.flush();
+
+		file.seekp(0);
+		OutputStream head(&file);
+		head.write(header.magic, sizeof(header.magic));
+		put(head, header.version);
+		put(head, header.nodeCount);
+		put(head, header.meshCount);
+		put(head, header.arrayCount);
+		put(head, header.stringBytes);
+		put(head, header.nodesOffset);
+		put(head, header.meshesOffset);
+		put(head, header.arraysOffset);
+		put(head, header.stringsOffset);
+		put(head, header.fileSize);
+		head.flush();
+		file.seekp(0, std::ios::end);
+		return header.fileSize;
+	}
+
+private:
+	// names, each stored once and NUL-terminated
+	struct Strings
+	{
+		std::string blob;
+		std::unordered_map<std::string, uint32_t> offsets;
+
+		uint32_t add(const std::string &s)
+		{
+			auto inserted = offsets.emplace(s, static_cast<uint32_t>(blob.size()));
+			if (inserted.second)
+			{
+				blob += s;
+				blob += '\0';
+			}
+			return inserted.first->second;
+		}
+	};
+
+	static FbxbMesh writeMesh(OutputStream &out, FbxMesh *pMesh, const ExportOptions &options, bool float32, ThreadPool *pool,
+		Strings &strings, std::vector<FbxbArray> &arrays)
+	{
+		TraceScope trace("export", "exportMesh", pMesh->GetName());
+		auto start = std::chrono::steady_clock::now();
+		Triangulation triangulation;
+		const std::vector<int> *corners = nullptr;
+		if (options.triangulate)
+		{
+			Triangulator::build(pMesh, triangulation, pool);
+			corners = &triangulation.corners;
+		}
+
+		FbxbMesh mesh = {};
+		mesh.id = pMesh->GetUniqueID();
+		mesh.name = strings.add(pMesh->GetName());
+		mesh.nameLength = static_cast<uint32_t>(std::strlen(pMesh->GetName()));
+		mesh.controlPointCount = pMesh->GetControlPointsCount();
+		mesh.firstArray = static_cast<uint32_t>(arrays.size());
+
+		// FbxVector4 is four packed doubles, w is dropped
+		arrays.push_back(writeFloats(out, FbxbArray::ePositions, 0, reinterpret_cast<const double *>(pMesh->GetControlPoints()),
+			pMesh->GetControlPointsCount(), 4, 3, nullptr, float32));
+
+		std::vector<int> offsets;
+		if (corners)
+		{
+			mesh.polygonCount = triangulation.triangleCount();
+			offsets.resize(static_cast<size_t>(mesh.polygonCount) + 1);
+			for (size_t t = 0; t < offsets.size(); t++)
+				offsets[t] = static_cast<int>(t * 3);
+		}
+		else
+		{
+			mesh.polygonCount = pMesh->GetPolygonCount();
+			offsets.resize(static_cast<size_t>(mesh.polygonCount) + 1);
+			for (int p = 0; p < pMesh->GetPolygonCount(); p++)
+				offsets[p + 1] = offsets[p] + pMesh->GetPolygonSize(p);
+		}
+		arrays.push_back(writeInts(out, FbxbArray::ePolygonVertices, pMesh->GetPolygonVertices(), pMesh->GetPolygonVertexCount(), corners));
+		mesh.polygonVertexCount = static_cast<uint32_t>(arrays.back().count);
+		arrays.push_back(writeInts(out, FbxbArray::ePolygonOffsets, offsets.data(), offsets.size(), nullptr));
+
+		if (options.allLayers)
+		{
+			for (int k = 0; k < pMesh->GetElementNormalCount(); k++)
+				writeElement(out, pMesh, FbxbArray::eNormals, k, pMesh->GetElementNormal(k), 3, corners, float32, arrays);
+		}
+		for (int k = 0; k < pMesh->GetElementUVCount(); k++)
+			writeElement(out, pMesh, FbxbArray::eUVs, k, pMesh->GetElementUV(k), 2, corners, float32, arrays);
+		for (int k = 0; k < pMesh->GetElementVertexColorCount(); k++)
+			writeElement(out, pMesh, FbxbArray::eColors, k, pMesh->GetElementVertexColor(k), 4, corners, float32, arrays);
+		mesh.arrayCount = static_cast<uint32_t>(arrays.size()) - mesh.firstArray;
+
+		if (options.stats)
+			options.stats->addMesh(pMesh, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		return mesh;
+	}
+
+	// one array per polygon vertex, left out when the element cannot be
+	// resolved that way
+	template <class T>
+	static void writeElement(OutputStream &out, FbxMesh *pMesh, FbxbArray::Semantic semantic, int set, const FbxLayerElementTemplate<T> *pElement,
+		int components, const std::vector<int> *corners, bool float32, std::vector<FbxbArray> &arrays)
+	{
+		std::vector<T> values;
+		if (!ResolveLayerElement(pMesh, pElement, LayerElementResolver<T>::ePolygonVertex, values))
+			return;
+		arrays.push_back(writeFloats(out, semantic, set, reinterpret_cast<const double *>(values.data()), values.size(),
+			LayerArrayTraits<T>::components, components, corners, float32));
+	}
+
+	// `count` tuples of the first `components` of every `stride` doubles, or
+	// the tuples `remap` picks
+	static FbxbArray writeFloats(OutputStream &out, FbxbArray::Semantic semantic, int set, const double *data, size_t count, int stride,
+		int components, const std::vector<int> *remap, bool float32)
+	{
+		FbxbArray array = startArray(out, semantic, set, float32 ? FbxbArray::eFloat32 : FbxbArray::eFloat64, components,
+			remap ? remap->size() : count);
+		for (size_t i = 0; i < array.count; i++)
+		{
+			const double *tuple = data + static_cast<size_t>(remap ? (*remap)[i] : i) * stride;
+			char *p = out.reserve(array.byteLength / array.count);
+			for (int c = 0; c < components; c++)
+			{
+				if (float32)
+					p = store(p, static_cast<float>(tuple[c]));
+				else
+					p = store(p, tuple[c]);
+			}
+			out.commit(p);
+		}
+		return array;
+	}
+
+	static FbxbArray writeInts(OutputStream &out, FbxbArray::Semantic semantic, const int *data, size_t count, const std::vector<int> *remap)
+	{
+		FbxbArray array = startArray(out, semantic, 0, FbxbArray::eInt32, 1, remap ? remap->size() : count);
+		const size_t chunk = 4096;
+		for (size_t i = 0; i < array.count; i += chunk)
+		{
+			size_t n = std::min(chunk, static_cast<size_t>(array.count) - i);
+			char *p = out.reserve(n * sizeof(int32_t));
+			for (size_t k = i; k < i + n; k++)
+				p = store(p, static_cast<int32_t>(data[remap ? (*remap)[k] : k]));
+			out.commit(p);
+		}
+		return array;
+	}
+
+	static FbxbArray startArray(OutputStream &out, FbxbArray::Semantic semantic, int set, FbxbArray::ComponentType type, int components,
+		size_t count)
+	{
+		FbxbArray array = {};
+		array.offset = align(out);
+		array.count = count;
+		array.byteLength = count * components * FbxbComponentSize(type);
+		array.semantic = semantic;
+		array.set = static_cast<uint16_t>(set);
+		array.componentType = type;
+		array.components = static_cast<uint16_t>(components);
+		return array;
+	}
+
+	// pads to the next multiple of fbxbAlignment, returns the new offset
+	static uint64_t align(OutputStream &out)
+	{
+		static const char zeros[fbxbAlignment] = {};
+		size_t misalign = out.tell() % fbxbAlignment;
+		if (misalign)
+			out.write(zeros, fbxbAlignment - misalign);
+		return out.tell();
+	}
+
+	// `value` little-endian at `p`, returns the end
+	template <class T>
+	static char *store(char *p, T value)
+	{
+		typedef typename std::conditional<sizeof(T) == 8, uint64_t, typename std::conditional<sizeof(T) == 4, uint32_t, uint16_t>::type>::type Bits;
+		Bits bits;
+		std::memcpy(&bits, &value, sizeof(T));
+		for (size_t b = 0; b < sizeof(T); b++)
+			p[b] = static_cast<char>(bits >> (8 * b));
+		return p + sizeof(T);
+	}
+
+	template <class T>
+	static void put(OutputStream &out, T value)
+	{
+		out.commit(store(out.reserve(sizeof(T)), value));
+	}
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <json.hpp>
+
+// How JSON text spells floating point numbers. By default it is the shortest
+// text that reads back as the same double, exactly as json::dump writes it.
+struct FloatFormat
+{
+	// significant digits, 0 for as many as the round trip needs
+	int precision = 0;
+	// the shortest text that reads back as the same float
+	bool float32 = false;
+
+	bool shortest() const { return precision == 0 && !float32; }
+};
+
+// 0 or 1..17 significant digits
+inline bool ParsePrecision(int digits, FloatFormat &format)
+{
+	if (digits < 0 || digits > std::numeric_limits<double>::max_digits10)
+		return false;
+	format.precision = digits;
+	return true;
+}
+
+// Formats finite doubles in place with the Grisu2 kernel behind json::dump.
+// The digits are produced once; float32 runs the kernel on the value rounded
+// to float and precision rounds the digits, and either way the number keeps
+// json::dump's layout (1.0, 0.001, 1e-05, 1.5e+20).
+class FloatFormatter
+{
+public:
+	// enough for any double in any format
+	static const size_t maxChars = 32;
+
+	// writes `value` at `out`, returns the end of the text
+	static char *write(char *out, double value, const FloatFormat &format)
+	{
+		if (format.shortest())
+			return nlohmann::detail::to_chars(out, out + maxChars, value);
+		if (std::signbit(value))
+		{
+			value = -value;
+			*out++ = '-';
+		}
+		if (value == 0)
+		{
+			*out++ = '0';
+			*out++ = '.';
+			*out++ = '0';
+			return out;
+		}
+		int len = 0;
+		int exponent = 0;
+		// doubles outside the float range keep their own digits
+		if (format.float32 && value <= std::numeric_limits<float>::max())
+		{
+			float single = static_cast<float>(value);
+			if (single == 0)
+			{
+				*out++ = '0';
+				*out++ = '.';
+				*out++ = '0';
+				return out;
+			}
+			value = single;
+			nlohmann::detail::dtoa_impl::grisu2(out, len, exponent, single);
+		}
+		else
+		{
+			nlohmann::detail::dtoa_impl::grisu2(out, len, exponent, value);
+		}
+		if (format.precision > 0 && len > format.precision)
+			roundDigits(out, len, exponent, format.precision, value);
+		return nlohmann::detail::dtoa_impl::format_buffer(out, len, exponent, -4, std::numeric_limits<double>::digits10);
+	}
+
+private:
+	// value = digits * 10^exponent, rounded to `precision` digits without
+	// trailing zeros. Rounding the shortest digits rounds the value itself,
+	// except when they end in a single 5 right after the cut: the value may
+	// lie on either side of that tie, so printf decides.
+	static void roundDigits(char *digits, int &len, int &exponent, int precision, double value)
+	{
+		bool up = digits[precision] >= '5';
+		if (digits[precision] == '5' && len == precision + 1)
+		{
+			// d.ddde-123
+			char exact[40];
+			std::snprintf(exact, sizeof(exact), "%.*e", precision - 1, value);
+			up = exact[0] != digits[0];
+			for (int i = 1; i < precision && !up; i++)
+				up = exact[i + 1] != digits[i];
+		}
+		exponent += len - precision;
+		len = precision;
+		if (up)
+		{
+			int i = len - 1;
+			for (; i >= 0 && digits[i] == '9'; i--)
+				digits[i] = '0';
+			if (i >= 0)
+			{
+				digits[i]++;
+			}
+			else
+			{
+				// 99.. rounded up to 100..
+				digits[0] = '1';
+				exponent += len;
+				len = 1;
+			}
+		}
+		while (len > 1 && digits[len - 1] == '0')
+		{
+			len--;
+			exponent++;
+		}
+	}
+};
@@ -0,0 +1,493 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./json_writer.h"
+
+// Forwards the event stream of exportScene to another writer and records
+// where nodes, meshes and bulk arrays land in the JSON text `text` writes,
+// for a table of contents that lets readers pread and parse one fragment
+// instead of the whole document. `next` is the text writer itself or a
+// writer over it. Value starts come from the text writer, so this has to be
+// the outermost writer. Over the text writer itself, fragments are its
+// fragments and are serialized in parallel; the events the toc needs are
+// kept with offsets into the fragment and moved to where it is spliced.
+class JsonTocWriter : public SceneWriter, private JsonTextWriter::Listener
+{
+public:
+	struct Range
+	{
+		size_t offset = 0;
+		size_t length = 0;
+	};
+	struct ArrayEntry
+	{
+		// keys and indices below the mesh or the scene, joined with '/'
+		std::string path;
+		Range range;
+		size_t count = 0;
+	};
+	struct MeshEntry
+	{
+		std::string name;
+		Range range;
+		std::vector<ArrayEntry> arrays;
+	};
+	struct NodeEntry
+	{
+		// as NodeFilter matches it, "" for the root
+		std::string path;
+		Range range;
+		// index into meshes, -1 without one
+		int64_t mesh = -1;
+	};
+
+	JsonTocWriter(SceneWriter &next, JsonTextWriter &text)
+		: mNext(next), mText(text), mAfterKey(false), mStart(none), mSpliceOffset(0), mSpliceIndent(0)
+	{
+		mText.setListener(this);
+	}
+	~JsonTocWriter() override { mText.setListener(nullptr); }
+
+	void startObject(size_t elements) override
+	{
+		mNext.startObject(elements);
+		handle(Event{eOpen, started()});
+	}
+	void endObject() override
+	{
+		mNext.endObject();
+		handle(Event{eClose, 0, mText.tell()});
+	}
+	void startArray(size_t elements) override
+	{
+		mNext.startArray(elements);
+		handle(Event{eOpen, started()});
+	}
+	void endArray() override
+	{
+		mNext.endArray();
+		handle(Event{eClose, 0, mText.tell()});
+	}
+	void key(const std::string &name) override
+	{
+		mNext.key(name);
+		handle(Event{eKey, 0, 0, 0, name});
+	}
+
+	void null() override
+	{
+		mNext.null();
+		handle(Event{eValue, started()});
+	}
+	void boolean(bool value) override
+	{
+		mNext.boolean(value);
+		handle(Event{eValue, started()});
+	}
+	void numberInteger(int64_t value) override
+	{
+		mNext.numberInteger(value);
+		handle(Event{eInteger, started(), 0, value});
+	}
+	void numberFloat(double value) override
+	{
+		mNext.numberFloat(value);
+		handle(Event{eValue, started()});
+	}
+	void string(const std::string &value) override
+	{
+		mNext.string(value);
+		handle(Event{eString, started(), 0, 0, value});
+	}
+
+	void intArray(const int *data, size_t count, int components = 1) override
+	{
+		mNext.intArray(data, count, components);
+		handle(Event{eArray, started(), mText.tell(), static_cast<int64_t>(count)});
+	}
+	void floatArray(const double *data, size_t count, int components = 1) override
+	{
+		mNext.floatArray(data, count, components);
+		handle(Event{eArray, started(), mText.tell(), static_cast<int64_t>(count)});
+	}
+	void polygonArray(const int *data, size_t count, size_t polygonCount) override
+	{
+		mNext.polygonArray(data, count, polygonCount);
+		handle(Event{eArray, started(), mText.tell(), static_cast<int64_t>(polygonCount)});
+	}
+
+	std::unique_ptr<SceneWriter> createFragment() override
+	{
+		// a writer in between may add text of its own, record and replay
+		if (&mNext != &mText)
+			return SceneWriter::createFragment();
+		return std::unique_ptr<SceneWriter>(new JsonTocWriter(mText.createFragment()));
+	}
+	void writeFragment(const SceneWriter &fragment) override
+	{
+		if (&mNext != &mText)
+		{
+			SceneWriter::writeFragment(fragment);
+			return;
+		}
+		const JsonTocWriter &toc = static_cast<const JsonTocWriter &>(fragment);
+		mNext.writeFragment(*toc.mOwnedText);
+		// fragment offsets move by the splice offset and by the indent added
+		// after every line break before them
+		const OutputStream &buffer = static_cast<const JsonTextFragment &>(*toc.mOwnedText).buffer();
+		std::vector<size_t> lineBreaks;
+		for (const char *p = buffer.data(), *end = p + buffer.size();
+			(p = static_cast<const char *>(std::memchr(p, '\n', end - p))) != nullptr; p++)
+			lineBreaks.push_back(p - buffer.data());
+		auto spliced = [&](size_t offset) {
+			size_t before = std::lower_bound(lineBreaks.begin(), lineBreaks.end(), offset) - lineBreaks.begin();
+			return mSpliceOffset + offset + before * mSpliceIndent;
+		};
+		for (Event e : toc.mEvents)
+		{
+			e.start = spliced(e.start);
+			e.end = spliced(e.end);
+			handle(e);
+		}
+	}
+
+	// nodes of the nested hierarchy; a node table is listed under arrays
+	const std::vector<NodeEntry> &nodes() const { return mNodes; }
+	const std::vector<MeshEntry> &meshes() const { return mMeshes; }
+	// the node and shared array tables, their containers and bulk arrays
+	const std::vector<ArrayEntry> &arrays() const { return mArrays; }
+
+	// {"file": name, "size": n, "nodes": [{"path", "offset", "length", "mesh"}],
+	//  "meshes": [{"name", "offset", "length", "arrays": [{"path", "offset", "length", "count"}]}],
+	//  "arrays": [...]}
+	void writeToc(SceneWriter &w, const std::string &file) const
+	{
+		w.startObject(5);
+		w.key("file");
+		w.string(file);
+		w.key("size");
+		w.numberInteger(mText.tell());
+		w.key("nodes");
+		w.startArray(mNodes.size());
+		for (const NodeEntry &node : mNodes)
+		{
+			w.startObject(4);
+			w.key("path");
+			w.string(node.path);
+			writeRange(w, node.range);
+			w.key("mesh");
+			w.numberInteger(node.mesh);
+			w.endObject();
+		}
+		w.endArray();
+		w.key("meshes");
+		w.startArray(mMeshes.size());
+		for (const MeshEntry &mesh : mMeshes)
+		{
+			w.startObject(4);
+			w.key("name");
+			w.string(mesh.name);
+			writeRange(w, mesh.range);
+			w.key("arrays");
+			writeArrays(w, mesh.arrays);
+			w.endObject();
+		}
+		w.endArray();
+		w.key("arrays");
+		writeArrays(w, mArrays);
+		w.endObject();
+	}
+
+private:
+	enum EventType
+	{
+		eOpen,
+		eClose,
+		eKey,
+		eValue,
+		eInteger,
+		eString,
+		eArray,
+	};
+	// what the toc needs of one event: where its value starts and, for the
+	// end of containers and bulk arrays, ends; the integer or the element
+	// count; the key or string
+	struct Event
+	{
+		Event(EventType t, size_t s = 0, size_t e = 0, int64_t v = 0, std::string x = std::string())
+			: type(t), start(s), end(e), value(v), text(std::move(x))
+		{
+		}
+		EventType type;
+		size_t start;
+		size_t end;
+		int64_t value;
+		std::string text;
+	};
+	enum Role
+	{
+		eOther,
+		// the exportScene object
+		eScene,
+		// a node object and the children array of one
+		eNode,
+		eChildren,
+		// the mesh table, a mesh object and any container inside one
+		eMeshTable,
+		eMesh,
+		eInMesh,
+		// "nodes" and "sharedArrays" of the scene
+		eSceneTable,
+	};
+	struct Frame
+	{
+		Role role = eOther;
+		// elements or keys written so far
+		size_t elements = 0;
+		std::string key;
+		// eNode: the node's parent path until its name is known, then its own;
+		// eChildren: the owner's path; eMesh, eInMesh, eSceneTable: the path
+		// below the mesh or the scene
+		std::string path;
+		// index into mNodes or mMeshes of the node or mesh the frame belongs to
+		int64_t entry = -1;
+		size_t offset = 0;
+	};
+	static const size_t none = static_cast<size_t>(-1);
+
+	// a fragment: events are kept with offsets into `text` until spliced
+	explicit JsonTocWriter(std::unique_ptr<SceneWriter> text)
+		: JsonTocWriter(*text, static_cast<JsonTextWriter &>(*text))
+	{
+		mOwnedText = std::move(text);
+	}
+
+	void valueStart(size_t offset) override
+	{
+		// writers in between may write several values for one event
+		if (mStart == none)
+			mStart = offset;
+	}
+	void fragmentSpliced(size_t offset, size_t indent) override
+	{
+		mSpliceOffset = offset;
+		mSpliceIndent = indent;
+	}
+	// where the value of the event just forwarded starts
+	size_t started()
+	{
+		size_t start = mStart;
+		mStart = none;
+		return start;
+	}
+
+	void handle(const Event &e)
+	{
+		if (mOwnedText)
+		{
+			mEvents.push_back(e);
+			return;
+		}
+		switch (e.type)
+		{
+		case eOpen:
+			mFrames.push_back(open(e.start, true));
+			break;
+		case eClose:
+			close(e.end);
+			break;
+		case eKey:
+			mFrames.back().key = e.text;
+			mFrames.back().elements++;
+			mAfterKey = true;
+			break;
+		case eValue:
+			open(e.start);
+			break;
+		case eInteger:
+			open(e.start);
+			// nodes refer to the mesh table by index, which is also the toc's
+			if (!mFrames.empty() && mFrames.back().role == eNode && mFrames.back().key == "mesh")
+				mNodes[mFrames.back().entry].mesh = e.value;
+			break;
+		case eString:
+			open(e.start);
+			named(e.text);
+			break;
+		case eArray:
+			addArray(open(e.start), e.end, static_cast<size_t>(e.value));
+			break;
+		}
+	}
+
+	void named(const std::string &value)
+	{
+		if (mFrames.empty() || mFrames.back().key != "name")
+			return;
+		Frame &parent = mFrames.back();
+		if (parent.role == eNode)
+		{
+			if (parent.entry > 0)
+				parent.path = parent.path.empty() ? value : parent.path + "/" + value;
+			mNodes[parent.entry].path = parent.path;
+		}
+		else if (parent.role == eMesh)
+			mMeshes[parent.entry].name = value;
+	}
+
+	// starts a value at `offset`: what it is from where it sits; only
+	// containers become nodes and meshes
+	Frame open(size_t offset, bool container = false)
+	{
+		Frame frame;
+		frame.offset = offset;
+		if (mFrames.empty())
+		{
+			frame.role = eScene;
+			return frame;
+		}
+		Frame &parent = mFrames.back();
+		std::string name;
+		if (mAfterKey)
+		{
+			mAfterKey = false;
+			name = parent.key;
+		}
+		else
+		{
+			name = std::to_string(parent.elements++);
+		}
+		switch (parent.role)
+		{
+		case eScene:
+			if (name == "RootNode" && container)
+			{
+				frame.role = eNode;
+				frame.entry = 0;
+				mNodes.assign(1, NodeEntry());
+				mNodes[0].range.offset = frame.offset;
+			}
+			else if (name == "meshes")
+				frame.role = eMeshTable;
+			else if (name == "nodes" || name == "sharedArrays")
+			{
+				frame.role = eSceneTable;
+				frame.path = name;
+			}
+			break;
+		case eNode:
+			if (name == "children")
+			{
+				frame.role = eChildren;
+				frame.path = parent.path;
+				frame.entry = parent.entry;
+			}
+			else if (name == "mesh" && container)
+			{
+				frame.role = eMesh;
+				mNodes[parent.entry].mesh = static_cast<int64_t>(mMeshes.size());
+			}
+			break;
+		case eChildren:
+			if (!container)
+				break;
+			frame.role = eNode;
+			frame.path = parent.path;
+			frame.entry = static_cast<int64_t>(mNodes.size());
+			mNodes.push_back(NodeEntry());
+			mNodes.back().range.offset = frame.offset;
+			break;
+		case eMeshTable:
+			if (container)
+				frame.role = eMesh;
+			break;
+		case eMesh:
+		case eInMesh:
+			frame.role = eInMesh;
+			frame.path = parent.role == eMesh ? name : parent.path + "/" + name;
+			frame.entry = parent.entry;
+			break;
+		case eSceneTable:
+			frame.role = eSceneTable;
+			frame.path = parent.path + "/" + name;
+			break;
+		default:
+			break;
+		}
+		if (frame.role == eMesh)
+		{
+			frame.entry = static_cast<int64_t>(mMeshes.size());
+			mMeshes.push_back(MeshEntry());
+			mMeshes.back().range.offset = frame.offset;
+		}
+		return frame;
+	}
+
+	void close(size_t end)
+	{
+		const Frame &frame = mFrames.back();
+		size_t length = end - frame.offset;
+		if (frame.role == eNode)
+			mNodes[frame.entry].range.length = length;
+		else if (frame.role == eMesh)
+			mMeshes[frame.entry].range.length = length;
+		else if (frame.role == eSceneTable)
+			mArrays.push_back(ArrayEntry{frame.path, Range{frame.offset, length}, frame.elements});
+		mFrames.pop_back();
+	}
+
+	void addArray(const Frame &frame, size_t end, size_t count)
+	{
+		ArrayEntry array;
+		array.path = frame.path;
+		array.range.offset = frame.offset;
+		array.range.length = end - frame.offset;
+		array.count = count;
+		if (frame.role == eInMesh)
+			mMeshes[frame.entry].arrays.push_back(array);
+		else if (frame.role == eSceneTable)
+			mArrays.push_back(array);
+	}
+
+	static void writeRange(SceneWriter &w, const Range &range)
+	{
+		w.key("offset");
+		w.numberInteger(range.offset);
+		w.key("length");
+		w.numberInteger(range.length);
+	}
+
+	static void writeArrays(SceneWriter &w, const std::vector<ArrayEntry> &arrays)
+	{
+		w.startArray(arrays.size());
+		for (const ArrayEntry &array : arrays)
+		{
+			w.startObject(4);
+			w.key("path");
+			w.string(array.path);
+			writeRange(w, array.range);
+			w.key("count");
+			w.numberInteger(array.count);
+			w.endObject();
+		}
+		w.endArray();
+	}
+
+	SceneWriter &mNext;
+	JsonTextWriter &mText;
+	// set for fragments, which only keep their events
+	std::unique_ptr<SceneWriter> mOwnedText;
+	std::vector<Event> mEvents;
+	bool mAfterKey;
+	size_t mStart;
+	size_t mSpliceOffset;
+	size_t mSpliceIndent;
+	std::vector<Frame> mFrames;
+	std::vector<NodeEntry> mNodes;
+	std::vector<MeshEntry> mMeshes;
+	std::vector<ArrayEntry> mArrays;
+};
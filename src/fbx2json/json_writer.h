@@ -0,0 +1,342 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <json.hpp>
+#include "./float_format.h"
+#include "./scene_writer.h"
+using json = nlohmann::ordered_json;
+
+// Streams JSON text with the exact layout of json::dump(4), so the output
+// is byte-identical to serializing the DOM but never holds the document.
+// A FloatFormat other than the default trades that for shorter numbers.
+class JsonTextWriter : public SceneWriter
+{
+public:
+	// Told where the text lands, for JsonTocWriter
+	class Listener
+	{
+	public:
+		virtual ~Listener() {}
+		// the value asked for starts at `offset`, after its separator and indent
+		virtual void valueStart(size_t offset) = 0;
+		// a fragment starts at `offset` and `indent` spaces were added after
+		// each of its line breaks
+		virtual void fragmentSpliced(size_t offset, size_t indent) = 0;
+	};
+
+	explicit JsonTextWriter(OutputStream &out, int indent = 4, const FloatFormat &format = FloatFormat())
+		: mOut(out), mIndent(indent), mAfterKey(false), mFormat(format), mListener(nullptr)
+	{
+	}
+
+	void setListener(Listener *listener) { mListener = listener; }
+	// bytes written so far
+	size_t tell() const { return mOut.tell(); }
+
+	void startObject(size_t) override
+	{
+		startValue();
+		open('{');
+	}
+	void endObject() override { close('}'); }
+	void startArray(size_t) override
+	{
+		startValue();
+		open('[');
+	}
+	void endArray() override { close(']'); }
+
+	void key(const std::string &name) override
+	{
+		nextElement();
+		writeString(name);
+		mOut.write(": ", 2);
+		mAfterKey = true;
+	}
+
+	void null() override
+	{
+		startValue();
+		mOut.write("null", 4);
+	}
+	void boolean(bool value) override
+	{
+		startValue();
+		if (value)
+			mOut.write("true", 4);
+		else
+			mOut.write("false", 5);
+	}
+	void numberInteger(int64_t value) override
+	{
+		startValue();
+		writeInteger(value);
+	}
+	void numberFloat(double value) override
+	{
+		startValue();
+		writeFloat(value);
+	}
+	// the base class loops without a virtual call per value
+	void intArray(const int *data, size_t count, int components = 1) override
+	{
+		JsonTextWriter::startArray(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (components != 1)
+				startNestedArray();
+			for (int c = 0; c < components; c++)
+			{
+				beforeValue();
+				writeInteger(data[i * components + c]);
+			}
+			if (components != 1)
+				JsonTextWriter::endArray();
+		}
+		JsonTextWriter::endArray();
+	}
+	void floatArray(const double *data, size_t count, int components = 1) override
+	{
+		JsonTextWriter::startArray(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (components != 1)
+				startNestedArray();
+			for (int c = 0; c < components; c++)
+			{
+				beforeValue();
+				writeFloat(data[i * components + c]);
+			}
+			if (components != 1)
+				JsonTextWriter::endArray();
+		}
+		JsonTextWriter::endArray();
+	}
+	void polygonArray(const int *data, size_t count, size_t polygonCount) override
+	{
+		JsonTextWriter::startArray(polygonCount);
+		size_t begin = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (data[i] >= 0)
+				continue;
+			startNestedArray();
+			for (; begin < i; begin++)
+			{
+				beforeValue();
+				writeInteger(data[begin]);
+			}
+			beforeValue();
+			writeInteger(~data[i]);
+			JsonTextWriter::endArray();
+			begin = i + 1;
+		}
+		JsonTextWriter::endArray();
+	}
+	void string(const std::string &value) override
+	{
+		startValue();
+		writeString(value);
+	}
+
+	// Fragments are serialized at depth 0 and re-indented while splicing.
+	std::unique_ptr<SceneWriter> createFragment() override;
+	void writeFragment(const SceneWriter &fragment) override;
+
+private:
+	// the separator and line break before an element, in one block
+	void nextElement()
+	{
+		if (mHasElements.empty())
+			return;
+		size_t indent = mHasElements.size() * mIndent;
+		char *p = mOut.reserve(indent + 2);
+		if (mHasElements.back())
+			*p++ = ',';
+		*p++ = '\n';
+		std::memset(p, ' ', indent);
+		mOut.commit(p + indent);
+		mHasElements.back() = true;
+	}
+	void beforeValue()
+	{
+		if (mAfterKey)
+			mAfterKey = false;
+		else
+			nextElement();
+	}
+	// beforeValue for the values callers ask for, which the listener hears of
+	void startValue()
+	{
+		beforeValue();
+		if (mListener)
+			mListener->valueStart(mOut.tell());
+	}
+	void open(char bracket)
+	{
+		mOut.put(bracket);
+		mHasElements.push_back(false);
+	}
+	// the tuples and polygons inside bulk arrays
+	void startNestedArray()
+	{
+		beforeValue();
+		open('[');
+	}
+	void close(char bracket)
+	{
+		bool hasElements = mHasElements.back();
+		mHasElements.pop_back();
+		if (hasElements)
+		{
+			mOut.put('\n');
+			writeIndent(mHasElements.size());
+		}
+		mOut.put(bracket);
+	}
+	void writeIndent(size_t depth)
+	{
+		static const char spaces[] = "                                                                ";
+		for (size_t left = depth * mIndent; left > 0;)
+		{
+			size_t n = std::min(left, sizeof(spaces) - 1);
+			mOut.write(spaces, n);
+			left -= n;
+		}
+	}
+	void writeInteger(int64_t value)
+	{
+		char buf[24];
+		char *end = buf + sizeof(buf);
+		char *p = end;
+		uint64_t abs = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+		do
+		{
+			*--p = static_cast<char>('0' + abs % 10);
+			abs /= 10;
+		} while (abs != 0);
+		if (value < 0)
+			*--p = '-';
+		mOut.write(p, end - p);
+	}
+	void writeFloat(double value)
+	{
+		if (!std::isfinite(value))
+		{
+			mOut.write("null", 4);
+			return;
+		}
+		char *p = mOut.reserve(FloatFormatter::maxChars);
+		mOut.commit(FloatFormatter::write(p, value, mFormat));
+	}
+	void writeString(const std::string &s)
+	{
+		for (char c : s)
+		{
+			// non-ASCII bytes are negative and take the slow path as well
+			if (c < 0x20 || c == 0x7f || c == '"' || c == '\\')
+			{
+				// let the library handle escaping and utf-8 validation; names
+				// from FBX files need not be UTF-8, invalid bytes become U+FFFD
+				mOut.write(json(s).dump(-1, ' ', false, json::error_handler_t::replace));
+				return;
+			}
+		}
+		mOut.put('"');
+		mOut.write(s);
+		mOut.put('"');
+	}
+
+	OutputStream &mOut;
+	size_t mIndent;
+	bool mAfterKey;
+	FloatFormat mFormat;
+	std::vector<bool> mHasElements;
+	Listener *mListener;
+};
+
+// JSON text serialized into memory, for JsonTextWriter::writeFragment.
+class JsonTextFragment : public JsonTextWriter
+{
+public:
+	JsonTextFragment(size_t indent, const FloatFormat &format)
+		: JsonTextWriter(mBuffer, indent, format)
+	{
+	}
+	const OutputStream &buffer() const { return mBuffer; }
+
+private:
+	// only referenced by the base class, never used before it is constructed
+	OutputStream mBuffer;
+};
+
+inline std::unique_ptr<SceneWriter> JsonTextWriter::createFragment()
+{
+	return std::unique_ptr<SceneWriter>(new JsonTextFragment(mIndent, mFormat));
+}
+
+inline void JsonTextWriter::writeFragment(const SceneWriter &fragment)
+{
+	const OutputStream &buffer = static_cast<const JsonTextFragment &>(fragment).buffer();
+	beforeValue();
+	if (mListener)
+		mListener->fragmentSpliced(mOut.tell(), mHasElements.size() * mIndent);
+	const char *p = buffer.data();
+	const char *end = p + buffer.size();
+	while (p < end)
+	{
+		// raw newlines only occur between tokens, strings escape theirs
+		const char *nl = static_cast<const char *>(std::memchr(p, '\n', end - p));
+		if (nl == nullptr)
+		{
+			mOut.write(p, end - p);
+			break;
+		}
+		mOut.write(p, nl + 1 - p);
+		writeIndent(mHasElements.size());
+		p = nl + 1;
+	}
+}
+
+// Collects the event stream into an ordered_json DOM.
+class JsonDomWriter : public SceneWriter
+{
+public:
+	void startObject(size_t) override { mStack.push_back(add(json::object())); }
+	void endObject() override { mStack.pop_back(); }
+	void startArray(size_t) override { mStack.push_back(add(json::array())); }
+	void endArray() override { mStack.pop_back(); }
+	void key(const std::string &name) override { mKey = name; }
+
+	void null() override { add(json(nullptr)); }
+	void boolean(bool value) override { add(json(value)); }
+	void numberInteger(int64_t value) override { add(json(value)); }
+	void numberFloat(double value) override { add(json(value)); }
+	void string(const std::string &value) override { add(json(value)); }
+
+	json &result() { return mRoot; }
+
+private:
+	json *add(json &&value)
+	{
+		if (mStack.empty())
+		{
+			mRoot = std::move(value);
+			return &mRoot;
+		}
+		json &parent = *mStack.back();
+		if (parent.is_array())
+		{
+			parent.push_back(std::move(value));
+			return &parent.back();
+		}
+		json &slot = parent[mKey];
+		slot = std::move(value);
+		return &slot;
+	}
+
+	json mRoot;
+	std::vector<json *> mStack;
+	std::string mKey;
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <fbxsdk.h>
+#include <vector>
+
+// FBX vector and color types are plain arrays of doubles, so a locked layer
+// array can be handed to the writers as one flat block of components.
+template <class T>
+struct LayerArrayTraits;
+template <>
+struct LayerArrayTraits<int>
+{
+	typedef int Component;
+	static const int components = 1;
+};
+template <>
+struct LayerArrayTraits<FbxVector2>
+{
+	typedef double Component;
+	static const int components = 2;
+};
+template <>
+struct LayerArrayTraits<FbxVector4>
+{
+	typedef double Component;
+	static const int components = 4;
+};
+template <>
+struct LayerArrayTraits<FbxColor>
+{
+	typedef double Component;
+	static const int components = 4;
+};
+
+static_assert(sizeof(FbxVector2) == 2 * sizeof(double), "FbxVector2 is expected to be two packed doubles");
+static_assert(sizeof(FbxVector4) == 4 * sizeof(double), "FbxVector4 is expected to be four packed doubles");
+static_assert(sizeof(FbxColor) == 4 * sizeof(double), "FbxColor is expected to be four packed doubles");
+
+// Read-locks a layer element array for the lifetime of the reader and exposes
+// its storage as contiguous memory. When the SDK refuses the lock (the array
+// is write-locked elsewhere) the elements are copied out with GetAt instead.
+template <class T>
+class LayerArrayReader
+{
+public:
+	typedef typename LayerArrayTraits<T>::Component Component;
+	static const int components = LayerArrayTraits<T>::components;
+
+	explicit LayerArrayReader(const FbxLayerElementArrayTemplate<T> &array)
+		: mArray(const_cast<FbxLayerElementArrayTemplate<T> &>(array)), mLocked(nullptr), mCount(array.GetCount())
+	{
+		if (mCount == 0)
+			return;
+		mLocked = mArray.GetLocked(mLocked, FbxLayerElementArray::eReadLock);
+		if (mLocked == nullptr)
+		{
+			mCopy.reserve(mCount);
+			for (int i = 0; i < mCount; ++i)
+				mCopy.push_back(mArray.GetAt(i));
+		}
+	}
+	~LayerArrayReader()
+	{
+		if (mLocked)
+			mArray.Release(&mLocked, mLocked);
+	}
+	LayerArrayReader(const LayerArrayReader &) = delete;
+	LayerArrayReader &operator=(const LayerArrayReader &) = delete;
+
+	const T *data() const { return mLocked ? mLocked : mCopy.data(); }
+	const Component *flat() const { return reinterpret_cast<const Component *>(data()); }
+	int count() const { return mCount; }
+
+private:
+	FbxLayerElementArrayTemplate<T> &mArray;
+	T *mLocked;
+	int mCount;
+	std::vector<T> mCopy;
+};
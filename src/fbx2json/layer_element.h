@@ -0,0 +1,171 @@
+#pragma once
+#include <fbxsdk.h>
+#include <algorithm>
+#include <vector>
+#include "./layer_array.h"
+
+// Expands a layer element into one value per polygon vertex or per control
+// point. The mapping and reference modes are looked at once per element and
+// pick a kernel specialized for them, so the per-vertex loops carry no
+// switches. Depends on nothing but the SDK and layer_array.h, so other tools
+// can include it on its own.
+// The JSON export writes index and direct arrays as stored and does not go
+// through here; expanded values are opt-in, through --vertex-buffer
+// (VertexWelder), --format fbxb and Fbx2Json::resolveVertexColors.
+template <class T>
+class LayerElementResolver
+{
+public:
+	enum Domain
+	{
+		// GetPolygonVertexCount() values, in polygon vertex order
+		ePolygonVertex,
+		// GetControlPointsCount() values; for elements mapped by polygon
+		// vertex or polygon, the last polygon vertex using the point wins and
+		// unused points get T()
+		eControlPoint,
+	};
+
+	// Fills `out`, returns false for unsupported modes (eByEdge, eNone,
+	// eIndex without indices) and for arrays too short or with indices
+	// outside the direct array.
+	static bool resolve(FbxMesh *pMesh, const FbxLayerElementTemplate<T> *pElement, Domain domain, std::vector<T> &out)
+	{
+		out.clear();
+		if (pMesh == nullptr || pElement == nullptr)
+			return false;
+		LayerArrayReader<T> direct(pElement->GetDirectArray());
+		if (pElement->GetReferenceMode() == FbxLayerElement::eDirect)
+			return resolveMapping(pMesh, pElement->GetMappingMode(), domain, direct.data(), DirectReference(direct.count()), out);
+
+		LayerArrayReader<int> index(pElement->GetIndexArray());
+		for (int i = 0; i < index.count(); i++)
+		{
+			if (static_cast<unsigned>(index.data()[i]) >= static_cast<unsigned>(direct.count()))
+				return false;
+		}
+		return resolveMapping(pMesh, pElement->GetMappingMode(), domain, direct.data(), IndexedReference(index.data(), index.count()), out);
+	}
+
+private:
+	// value `i` of the mapping is direct[i]
+	struct DirectReference
+	{
+		explicit DirectReference(int n) : count(n) {}
+		int operator()(int i) const { return i; }
+		int count;
+	};
+	// value `i` of the mapping is direct[index[i]]
+	struct IndexedReference
+	{
+		IndexedReference(const int *p, int n) : index(p), count(n) {}
+		int operator()(int i) const { return index[i]; }
+		const int *index;
+		int count;
+	};
+
+	template <class TReference>
+	static bool resolveMapping(FbxMesh *pMesh, FbxLayerElement::EMappingMode mapping, Domain domain, const T *direct,
+		TReference reference, std::vector<T> &out)
+	{
+		int lPolygonVertexCount = pMesh->GetPolygonVertexCount();
+		int lControlPointCount = pMesh->GetControlPointsCount();
+		const int *pPolygonVertices = pMesh->GetPolygonVertices();
+		// the kernels that go through the polygon vertices rely on them
+		// pointing at control points
+		bool byPoint = mapping == FbxLayerElement::eByControlPoint;
+		bool byCorner = mapping == FbxLayerElement::eByPolygonVertex || mapping == FbxLayerElement::eByPolygon;
+		if ((byPoint && domain == ePolygonVertex) || (byCorner && domain == eControlPoint))
+		{
+			for (int i = 0; i < lPolygonVertexCount; i++)
+			{
+				if (static_cast<unsigned>(pPolygonVertices[i]) >= static_cast<unsigned>(lControlPointCount))
+					return false;
+			}
+		}
+		switch (mapping)
+		{
+		case FbxLayerElement::eByControlPoint:
+			if (reference.count < lControlPointCount)
+				return false;
+			if (domain == eControlPoint)
+			{
+				out.resize(lControlPointCount);
+				mapIdentity(direct, reference, out.data(), lControlPointCount);
+				return true;
+			}
+			out.resize(lPolygonVertexCount);
+			mapThrough(direct, reference, pPolygonVertices, out.data(), lPolygonVertexCount);
+			return true;
+		case FbxLayerElement::eByPolygonVertex:
+			if (reference.count < lPolygonVertexCount)
+				return false;
+			if (domain == ePolygonVertex)
+			{
+				out.resize(lPolygonVertexCount);
+				mapIdentity(direct, reference, out.data(), lPolygonVertexCount);
+				return true;
+			}
+			out.assign(lControlPointCount, T());
+			scatter(direct, reference, pPolygonVertices, out.data(), lPolygonVertexCount);
+			return true;
+		case FbxLayerElement::eByPolygon:
+		{
+			int lPolygonCount = pMesh->GetPolygonCount();
+			if (reference.count < lPolygonCount)
+				return false;
+			std::vector<T> perVertex(lPolygonVertexCount);
+			for (int p = 0, lStart = 0; p < lPolygonCount; lStart += pMesh->GetPolygonSize(p++))
+			{
+				if (lStart + pMesh->GetPolygonSize(p) > lPolygonVertexCount)
+					return false;
+				std::fill(perVertex.begin() + lStart, perVertex.begin() + lStart + pMesh->GetPolygonSize(p), direct[reference(p)]);
+			}
+			if (domain == ePolygonVertex)
+			{
+				out.swap(perVertex);
+				return true;
+			}
+			out.assign(lControlPointCount, T());
+			scatter(perVertex.data(), DirectReference(lPolygonVertexCount), pPolygonVertices, out.data(), lPolygonVertexCount);
+			return true;
+		}
+		case FbxLayerElement::eAllSame:
+			if (reference.count < 1)
+				return false;
+			out.assign(domain == ePolygonVertex ? lPolygonVertexCount : lControlPointCount, direct[reference(0)]);
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	template <class TReference>
+	static void mapIdentity(const T *direct, TReference reference, T *out, int count)
+	{
+		for (int i = 0; i < count; i++)
+			out[i] = direct[reference(i)];
+	}
+
+	template <class TReference>
+	static void mapThrough(const T *direct, TReference reference, const int *points, T *out, int count)
+	{
+		for (int i = 0; i < count; i++)
+			out[i] = direct[reference(points[i])];
+	}
+
+	template <class TReference>
+	static void scatter(const T *direct, TReference reference, const int *points, T *out, int count)
+	{
+		for (int i = 0; i < count; i++)
+			out[points[i]] = direct[reference(i)];
+	}
+};
+
+// ResolveLayerElement(pMesh, pMesh->GetElementUV(0), LayerElementResolver<FbxVector2>::ePolygonVertex, uvs)
+template <class T>
+bool ResolveLayerElement(FbxMesh *pMesh, const FbxLayerElementTemplate<T> *pElement,
+	typename LayerElementResolver<T>::Domain domain, std::vector<T> &out)
+{
+	return LayerElementResolver<T>::resolve(pMesh, pElement, domain, out);
+}
@@ -1,18 +1,179 @@
-#include "./fbx2json.h"
+#include "./converter.h"
+#include "./server.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <iostream>
 #include <cxxopts.hpp>
 #include <fstream>
 #include <string>
+#include <thread>
 typedef cxxopts::Options CmdOptions;
 
+struct BatchItem
+{
+    std::string input;
+    std::string output;
+    ConvertResult result;
+};
+
+// one input per line, optionally followed by a tab and the output path
+static bool ReadBatchList(const std::string &listFile, OutputFormat format, std::vector<BatchItem> &items)
+{
+    std::ifstream in(listFile);
+    if (!in)
+        return false;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+        BatchItem item;
+        size_t tab = line.find('\t');
+        item.input = line.substr(0, tab);
+        item.output = tab == std::string::npos ? DefaultOutputPath(item.input, format) : line.substr(tab + 1);
+        items.push_back(item);
+    }
+    return true;
+}
+
+// Converts every item with `jobs` workers, each owning one FbxManager that is
+// reused for all the files it picks up.
+static void RunBatch(std::vector<BatchItem> &items, const ConvertOptions &options, unsigned jobs)
+{
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        PhaseTimer initTimer;
+        FbxManager *pManager = nullptr;
+        {
+            TraceScope trace("phase", "init");
+            InitializeSdkManager(pManager);
+        }
+        PhaseStats init = initTimer.stop("init");
+        bool first = true;
+        for (size_t i = next++; i < items.size(); i = next++)
+        {
+            items[i].result = ConvertFile(pManager, items[i].input, items[i].output, options);
+            // the manager's setup is charged to the first file it converts
+            if (first)
+                items[i].result.stats.phases.insert(items[i].result.stats.phases.begin(), init);
+            first = false;
+        }
+        DestroySdkObjects(pManager, false);
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < jobs && i < items.size(); i++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &t : threads)
+        t.join();
+}
+
+static void PrintPhases(const ConvertStats &stats)
+{
+    for (const PhaseStats &phase : stats.phases)
+    {
+        char line[96];
+        snprintf(line, sizeof(line), "    %-10s %8.3fs wall %8.3fs cpu %8.1f MB peak RSS",
+                 phase.name.c_str(), phase.wallSeconds, phase.cpuSeconds, phase.peakRssBytes / 1048576.0);
+        std::cout << line << std::endl;
+    }
+    std::cout << "    " << stats.jsonBytes + stats.binBytes + stats.tocBytes << " bytes written" << std::endl;
+    if (stats.dedup.sharedArrays)
+        std::cout << "    " << stats.dedup.references << " of " << stats.dedup.arrays << " arrays shared through "
+                  << stats.dedup.sharedArrays << " table entries, " << stats.dedup.bytesSaved << " array bytes saved" << std::endl;
+}
+
+static bool WriteStats(const std::string &path, const std::vector<BatchItem> &items)
+{
+    json files = json::array();
+    for (const BatchItem &item : items)
+    {
+        json file;
+        file["input"] = item.input;
+        file["output"] = item.output;
+        file["success"] = item.result.success;
+        file["error"] = item.result.error;
+        file["seconds"] = item.result.seconds;
+        file.update(StatsToJson(item.result.stats));
+        files.push_back(file);
+    }
+    json stats;
+    stats["files"] = files;
+    std::ofstream out(path);
+    out << stats.dump(4) << std::endl;
+    return out.good();
+}
+
+static int WriteTrace(const cxxopts::ParseResult &result, int status)
+{
+    if (result.count("trace") && !Trace::write(result["trace"].as<std::string>()))
+    {
+        std::cout << "Cannot write " << result["trace"].as<std::string>() << std::endl;
+        return 1;
+    }
+    return status;
+}
+
+static int PrintBatchSummary(const std::vector<BatchItem> &items, bool verbose)
+{
+    size_t failed = 0;
+    double seconds = 0;
+    std::cout << std::endl << "status  seconds  import  file" << std::endl;
+    for (const BatchItem &item : items)
+    {
+        char timing[32];
+        snprintf(timing, sizeof(timing), "%7.3f  %6.3f", item.result.seconds, item.result.importSeconds);
+        std::cout << (item.result.success ? "ok    " : "FAILED") << "  " << timing << "  " << item.input;
+        if (!item.result.success)
+            std::cout << " (" << item.result.error << ")";
+        std::cout << std::endl;
+        if (verbose)
+            PrintPhases(item.result.stats);
+        failed += item.result.success ? 0 : 1;
+        seconds += item.result.seconds;
+    }
+    std::cout << items.size() - failed << " of " << items.size() << " files converted, "
+              << seconds << "s spent converting" << std::endl;
+    return failed ? 1 : 0;
+}
+
 int main(int argc, char **argv)
 {
     CmdOptions options(argv[0], " - FBX to JSON converter");
     options.add_options()
         ("help,h", "Print help")
-        ("input,i", "Input FBX file", cxxopts::value<std::string>())
-        ("output,o", "Output JSON file", cxxopts::value<std::string>())
-        ("verbose,v", "Print verbose output");
+        ("input,i", "Input FBX file, may be repeated", cxxopts::value<std::vector<std::string>>())
+        ("output,o", "Output file", cxxopts::value<std::string>())
+        ("format", "Output encoding: json, cbor, msgpack, ubjson or fbxb (memory-mappable tables and arrays)", cxxopts::value<std::string>()->default_value("json"))
+        ("batch", "Convert the files listed in a text file, one input per line with an optional tab separated output", cxxopts::value<std::string>())
+        ("jobs", "Number of files converted at once in batch and serve mode", cxxopts::value<unsigned>()->default_value("1"))
+        ("serve", "Keep running and convert newline-delimited JSON requests read from stdin")
+        ("socket", "Serve requests on this Unix domain socket instead of stdin", cxxopts::value<std::string>())
+        ("binary-buffers", "Write large arrays to a companion .bin file")
+        ("toc", "Write the byte offsets of nodes, meshes and their arrays in the JSON output to a companion .toc.json file")
+        ("all-layers", "Also export normals, tangents, binormals, smoothing and materials")
+        ("point-adjacency", "Add the polygon vertices of every control point to meshes, as CSR offsets and indices")
+        ("triangulate", "Write meshes as triangles, fanning convex polygons and ear clipping concave ones")
+        ("mesh-table", "Write each distinct mesh once into a top-level meshes table that nodes reference by index")
+        ("node-table", "Write the hierarchy as a flat preorder nodes table with parent and child indices, implies --mesh-table")
+        ("dedup-arrays", "Write arrays that are identical across meshes once into a top-level sharedArrays table")
+        ("polygon-layout", "Polygon encoding: nested or csr", cxxopts::value<std::string>()->default_value("nested"))
+        ("vertex-buffer", "Add welded vertices and an index buffer to every mesh: none, interleaved or separate", cxxopts::value<std::string>()->default_value("none"))
+        ("precision", "Write JSON numbers with at most N significant digits, 0 for the shortest exact text", cxxopts::value<int>()->default_value("0"))
+        ("float32", "Write JSON numbers as the shortest text that reads back as the same float")
+        ("include", "Only export nodes whose path matches this glob, and their subtrees (repeatable)", cxxopts::value<std::vector<std::string>>())
+        ("exclude", "Skip nodes whose path matches this glob, and their subtrees (repeatable)", cxxopts::value<std::vector<std::string>>())
+        ("type", "Only export nodes with these attribute types, e.g. mesh,skeleton,camera", cxxopts::value<std::vector<std::string>>())
+        ("max-depth", "Skip nodes deeper than this below the root", cxxopts::value<int>()->default_value("-1"))
+        ("import-profile", "What to import: auto, geometry, rig or full", cxxopts::value<std::string>()->default_value("auto"))
+        ("validate", "Checks after import: none, fast (own linear checks) or full (FBX SDK scene check)", cxxopts::value<std::string>()->default_value("full"))
+        ("threads,j", "Export meshes on N threads, 0 for all cores", cxxopts::value<unsigned>()->default_value("1"))
+        ("stats", "Write per-phase timings, memory use, output sizes and per-mesh statistics to this JSON file; in serve mode they are added to the replies", cxxopts::value<std::string>())
+        ("trace", "Write a Chrome trace-event timeline (chrome://tracing, Perfetto) to this file; in serve mode it is written on shutdown", cxxopts::value<std::string>())
+        ("verbose,v", "Print the time, CPU time and peak memory of every phase");
 
     auto result = options.parse(argc, argv);
     if (result.count("help"))
@@ -20,32 +181,153 @@ int main(int argc, char **argv)
         std::cout << options.help() << std::endl;
         return 0;
     }
-    if (result.count("input") == 0)
+    bool serve = result.count("serve") || result.count("socket");
+    if (result.count("input") == 0 && result.count("batch") == 0 && !serve)
     {
         std::cout << "Input file is required" << std::endl;
         return 1;
     }
-    if (result.count("output") == 0)
+    bool verbose = result.count("verbose") > 0;
+
+    ConvertOptions convertOptions;
+    ExportOptions &exportOptions = convertOptions.exportOptions;
+    convertOptions.binaryBuffers = result.count("binary-buffers") > 0;
+    convertOptions.toc = result.count("toc") > 0;
+    convertOptions.floatFormat.float32 = result.count("float32") > 0;
+    if (!ParsePrecision(result["precision"].as<int>(), convertOptions.floatFormat))
+    {
+        std::cout << "Precision must be between 0 and 17: " << result["precision"].as<int>() << std::endl;
+        return 1;
+    }
+    std::string format = result["format"].as<std::string>();
+    if (!ParseOutputFormat(format, convertOptions.format))
+    {
+        std::cout << "Unknown output format: " << format << std::endl;
+        return 1;
+    }
+    convertOptions.collectStats = result.count("stats") > 0;
+    exportOptions.allLayers = result.count("all-layers") > 0;
+    exportOptions.pointAdjacency = result.count("point-adjacency") > 0;
+    exportOptions.triangulate = result.count("triangulate") > 0;
+    exportOptions.meshTable = result.count("mesh-table") > 0;
+    exportOptions.nodeTable = result.count("node-table") > 0;
+    exportOptions.dedupArrays = result.count("dedup-arrays") > 0;
+    exportOptions.threads = result["threads"].as<unsigned>();
+    if (result.count("include"))
+        exportOptions.filter.include = result["include"].as<std::vector<std::string>>();
+    if (result.count("exclude"))
+        exportOptions.filter.exclude = result["exclude"].as<std::vector<std::string>>();
+    if (result.count("type"))
+        exportOptions.filter.types = result["type"].as<std::vector<std::string>>();
+    exportOptions.filter.maxDepth = result["max-depth"].as<int>();
+    std::string polygonLayout = result["polygon-layout"].as<std::string>();
+    if (polygonLayout == "csr")
+    {
+        exportOptions.polygonLayout = ExportOptions::eCsrPolygons;
+    }
+    else if (polygonLayout != "nested")
+    {
+        std::cout << "Unknown polygon layout: " << polygonLayout << std::endl;
+        return 1;
+    }
+
+    std::string vertexBuffer = result["vertex-buffer"].as<std::string>();
+    if (!ParseVertexBufferLayout(vertexBuffer, exportOptions.vertexBuffer))
+    {
+        std::cout << "Unknown vertex buffer layout: " << vertexBuffer << std::endl;
+        return 1;
+    }
+
+    std::string importProfile = result["import-profile"].as<std::string>();
+    if (importProfile != "auto")
+    {
+        convertOptions.autoImportProfile = false;
+        if (!ParseImportProfile(importProfile.c_str(), convertOptions.importProfile))
+        {
+            std::cout << "Unknown import profile: " << importProfile << std::endl;
+            return 1;
+        }
+    }
+
+    std::string validate = result["validate"].as<std::string>();
+    if (!ParseValidationMode(validate, convertOptions.validation))
+    {
+        std::cout << "Unknown validation mode: " << validate << std::endl;
+        return 1;
+    }
+
+    if (result.count("trace"))
+        Trace::start();
+
+    if (serve)
+    {
+        unsigned jobs = std::max(1u, result["jobs"].as<unsigned>());
+        if (result.count("socket"))
+            return WriteTrace(result, ServeSocket(result["socket"].as<std::string>(), convertOptions, jobs));
+        return WriteTrace(result, ServeStdio(convertOptions, jobs));
+    }
+
+    std::vector<BatchItem> items;
+    if (result.count("batch") && !ReadBatchList(result["batch"].as<std::string>(), convertOptions.format, items))
     {
-        std::cout << "Output file is required" << std::endl;
+        std::cout << "Cannot read batch list " << result["batch"].as<std::string>() << std::endl;
         return 1;
     }
-    if (result.count("verbose"))
+    if (result.count("input"))
     {
-        std::cout << "Verbose output" << std::endl;
+        for (const std::string &input : result["input"].as<std::vector<std::string>>())
+        {
+            BatchItem item;
+            item.input = input;
+            item.output = DefaultOutputPath(input, convertOptions.format);
+            items.push_back(item);
+        }
     }
-    std::string input = result["input"].as<std::string>();
-    std::string output = result["output"].as<std::string>();
 
-    FbxManager *pManager = nullptr;
-    FbxScene *pScene = nullptr;
-    InitializeSdkObjects(pManager, pScene);
-    int fbxFileVersion = -1;
-    if (LoadScene(pManager, pScene, input.c_str(), fbxFileVersion))
+    // a single conversion keeps the plain -i/-o behaviour
+    if (items.size() == 1 && result.count("batch") == 0)
     {
-        json j = Fbx2Json::exportScene(pScene);
-        std::ofstream out(output);
-        out << j.dump(4);
+        if (result.count("output") == 0)
+        {
+            std::cout << "Output file is required" << std::endl;
+            return 1;
+        }
+        PhaseTimer initTimer;
+        FbxManager *pManager = nullptr;
+        {
+            TraceScope trace("phase", "init");
+            InitializeSdkManager(pManager);
+        }
+        PhaseStats init = initTimer.stop("init");
+        BatchItem &item = items[0];
+        item.output = result["output"].as<std::string>();
+        item.result = ConvertFile(pManager, item.input, item.output, convertOptions);
+        item.result.stats.phases.insert(item.result.stats.phases.begin(), init);
+        if (!item.result.success && !item.result.error.empty())
+        {
+            std::cout << item.result.error << std::endl;
+        }
+        if (verbose)
+            PrintPhases(item.result.stats);
+        if (result.count("stats") && !WriteStats(result["stats"].as<std::string>(), items))
+        {
+            std::cout << "Cannot write " << result["stats"].as<std::string>() << std::endl;
+            return 1;
+        }
+        return WriteTrace(result, item.result.success ? 0 : 1);
+    }
+    if (result.count("output"))
+    {
+        std::cout << "--output only applies to a single input, batch outputs go next to the inputs or into the list" << std::endl;
+        return 1;
+    }
+
+    RunBatch(items, convertOptions, std::max(1u, result["jobs"].as<unsigned>()));
+    int status = PrintBatchSummary(items, verbose);
+    if (result.count("stats") && !WriteStats(result["stats"].as<std::string>(), items))
+    {
+        std::cout << "Cannot write " << result["stats"].as<std::string>() << std::endl;
+        return 1;
     }
-    return 0;
-}
\ No newline at end of file
+    return WriteTrace(result, status);
+}
@@ -0,0 +1,207 @@
+#pragma once
+#include <fbxsdk.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Which nodes of the scene to export. Paths are the node names below the
+// exported root joined with '/', e.g. "Character/Body/LOD0".
+struct NodeFilter
+{
+	// globs on the node path; a match selects the node and its subtree.
+	// Empty selects everything.
+	std::vector<std::string> include;
+	// globs on the node path; a match drops the node and its subtree
+	std::vector<std::string> exclude;
+	// attribute type names (mesh, skeleton, camera, ..., none); only nodes of
+	// these types are selected. Empty allows every type.
+	std::vector<std::string> types;
+	// nodes deeper than this below the root are dropped, -1 for no limit
+	int maxDepth = -1;
+
+	bool empty() const { return include.empty() && exclude.empty() && types.empty() && maxDepth < 0; }
+};
+
+// '*' matches within one path segment, '**' across segments, '?' one character.
+// "**/" also matches no segments at all, so "**/UCX_*" matches a top-level
+// UCX_box and "a/**/b" matches a/b.
+inline bool GlobMatch(const char *pattern, const char *text)
+{
+	if (*pattern == '\0')
+		return *text == '\0';
+	if (pattern[0] == '*' && pattern[1] == '*')
+	{
+		if (pattern[2] == '/' && GlobMatch(pattern + 3, text))
+			return true;
+		for (const char *t = text;; t++)
+		{
+			if (GlobMatch(pattern + 2, t))
+				return true;
+			if (*t == '\0')
+				return false;
+		}
+	}
+	if (*pattern == '*')
+	{
+		for (const char *t = text;; t++)
+		{
+			if (GlobMatch(pattern + 1, t))
+				return true;
+			if (*t == '\0' || *t == '/')
+				return false;
+		}
+	}
+	if (*text == '\0')
+		return false;
+	if (*pattern == '?' ? *text != '/' : *pattern == *text)
+		return GlobMatch(pattern + 1, text + 1);
+	return false;
+}
+
+inline const char *AttributeTypeName(const FbxNode *pNode)
+{
+	const FbxNodeAttribute *attr = pNode->GetNodeAttribute();
+	if (attr == nullptr)
+		return "none";
+	switch (attr->GetAttributeType())
+	{
+	case FbxNodeAttribute::eNull: return "null";
+	case FbxNodeAttribute::eMarker: return "marker";
+	case FbxNodeAttribute::eSkeleton: return "skeleton";
+	case FbxNodeAttribute::eMesh: return "mesh";
+	case FbxNodeAttribute::eNurbs: return "nurbs";
+	case FbxNodeAttribute::ePatch: return "patch";
+	case FbxNodeAttribute::eCamera: return "camera";
+	case FbxNodeAttribute::eCameraStereo: return "cameraStereo";
+	case FbxNodeAttribute::eCameraSwitcher: return "cameraSwitcher";
+	case FbxNodeAttribute::eLight: return "light";
+	case FbxNodeAttribute::eOpticalReference: return "opticalReference";
+	case FbxNodeAttribute::eOpticalMarker: return "opticalMarker";
+	case FbxNodeAttribute::eNurbsCurve: return "nurbsCurve";
+	case FbxNodeAttribute::eTrimNurbsSurface: return "trimNurbsSurface";
+	case FbxNodeAttribute::eBoundary: return "boundary";
+	case FbxNodeAttribute::eNurbsSurface: return "nurbsSurface";
+	case FbxNodeAttribute::eShape: return "shape";
+	case FbxNodeAttribute::eLODGroup: return "lodGroup";
+	case FbxNodeAttribute::eSubDiv: return "subdiv";
+	case FbxNodeAttribute::eCachedEffect: return "cachedEffect";
+	case FbxNodeAttribute::eLine: return "line";
+	default: return "unknown";
+	}
+}
+
+// Result of applying a NodeFilter to a subtree. Only names and attribute
+// types are looked at, so no geometry is touched for pruned nodes. Selected
+// nodes export their mesh; unselected ancestors of selected nodes are kept
+// with a null mesh so the hierarchy stays intact. The root is always kept.
+class NodeSelection
+{
+public:
+	NodeSelection(FbxNode *root, const NodeFilter &filter)
+		: mFilter(filter)
+	{
+		visit(root);
+		mNodes[root];
+	}
+
+	bool contains(FbxNode *node) const { return mNodes.count(node) != 0; }
+	bool selected(FbxNode *node) const
+	{
+		auto it = mNodes.find(node);
+		return it != mNodes.end() && it->second.selected;
+	}
+	int childCount(FbxNode *node) const
+	{
+		auto it = mNodes.find(node);
+		return it == mNodes.end() ? 0 : it->second.childCount;
+	}
+
+private:
+	struct Entry
+	{
+		bool selected = false;
+		int childCount = 0;
+	};
+
+	static bool matchesAny(const std::vector<std::string> &patterns, const std::string &path)
+	{
+		for (const std::string &p : patterns)
+		{
+			if (GlobMatch(p.c_str(), path.c_str()))
+				return true;
+		}
+		return false;
+	}
+
+	// An explicit-stack preorder pass followed by a reverse sweep that adds
+	// each kept node to its parent's child count, so deep chains neither
+	// recurse nor build paths when no glob needs them.
+	void visit(FbxNode *root)
+	{
+		bool needPaths = !mFilter.include.empty() || !mFilter.exclude.empty();
+		struct Pending
+		{
+			FbxNode *node;
+			// index into visited, -1 for the root
+			int parent;
+			int depth;
+			bool included;
+			std::string path;
+		};
+		struct Visited
+		{
+			FbxNode *node;
+			int parent;
+			Entry entry;
+		};
+		std::vector<Visited> visited;
+		std::vector<Pending> stack;
+		stack.push_back(Pending{root, -1, 0, false, std::string()});
+		while (!stack.empty())
+		{
+			Pending pending = std::move(stack.back());
+			stack.pop_back();
+			if (mFilter.maxDepth >= 0 && pending.depth > mFilter.maxDepth)
+				continue;
+			if (pending.depth > 0 && matchesAny(mFilter.exclude, pending.path))
+				continue;
+			bool included = pending.included || mFilter.include.empty() || (pending.depth > 0 && matchesAny(mFilter.include, pending.path));
+
+			bool selected = included;
+			if (selected && !mFilter.types.empty())
+			{
+				std::string type = AttributeTypeName(pending.node);
+				selected = false;
+				for (const std::string &t : mFilter.types)
+					selected = selected || t == type;
+			}
+
+			int index = static_cast<int>(visited.size());
+			visited.push_back(Visited{pending.node, pending.parent, Entry()});
+			visited.back().entry.selected = selected;
+			FbxNode *node = pending.node;
+			for (int i = node->GetChildCount() - 1; i >= 0; i--)
+			{
+				FbxNode *child = node->GetChild(i);
+				std::string childPath;
+				if (needPaths)
+					childPath = pending.path.empty() ? child->GetName() : pending.path + "/" + child->GetName();
+				stack.push_back(Pending{child, index, pending.depth + 1, included, std::move(childPath)});
+			}
+		}
+
+		// children come after their parent in preorder
+		for (size_t i = visited.size(); i-- > 0;)
+		{
+			const Visited &v = visited[i];
+			if (!v.entry.selected && v.entry.childCount == 0)
+				continue;
+			if (v.parent >= 0)
+				visited[v.parent].entry.childCount++;
+			mNodes[v.node] = v.entry;
+		}
+	}
+
+	const NodeFilter &mFilter;
+	std::unordered_map<FbxNode *, Entry> mNodes;
+};
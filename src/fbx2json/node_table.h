@@ -0,0 +1,80 @@
+#pragma once
+#include <fbxsdk.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The node hierarchy as one preorder table in structure-of-arrays form. It is
+// built with an explicit stack, so neither writing nor reading it recurses
+// however deep the hierarchy is. Node 0 is the root; the children of node i
+// are firstChild[i], nextSibling[firstChild[i]], ... until -1, and in
+// preorder firstChild[i] is i + 1 whenever childCount[i] > 0.
+struct NodeTable
+{
+	// distinct node names in the order they are first seen
+	std::vector<std::string> strings;
+	// per node, an index into strings
+	std::vector<int> name;
+	// per node, -1 for the root
+	std::vector<int> parent;
+	// per node, -1 for leaves and the last child of a parent
+	std::vector<int> firstChild;
+	std::vector<int> nextSibling;
+	std::vector<int> childCount;
+	// per node, the node itself and its mesh or null
+	std::vector<FbxNode *> nodes;
+	std::vector<FbxMesh *> meshes;
+
+	int size() const { return static_cast<int>(nodes.size()); }
+
+	// `contains(node)` tells whether a child and its subtree are kept,
+	// `meshOf(node)` which mesh a kept node carries
+	template <class TContains, class TMeshOf>
+	static void build(FbxNode *root, TContains contains, TMeshOf meshOf, NodeTable &table)
+	{
+		table = NodeTable();
+		std::unordered_map<std::string, int> interned;
+		// per node, the last child added so far
+		std::vector<int> lastChild;
+		struct Pending
+		{
+			FbxNode *node;
+			int parent;
+		};
+		std::vector<Pending> stack(1, Pending{root, -1});
+		while (!stack.empty())
+		{
+			Pending pending = stack.back();
+			stack.pop_back();
+			FbxNode *node = pending.node;
+			int i = table.size();
+			auto inserted = interned.emplace(node->GetName(), static_cast<int>(table.strings.size()));
+			if (inserted.second)
+				table.strings.push_back(node->GetName());
+			table.name.push_back(inserted.first->second);
+			table.parent.push_back(pending.parent);
+			table.firstChild.push_back(-1);
+			table.nextSibling.push_back(-1);
+			table.childCount.push_back(0);
+			table.nodes.push_back(node);
+			table.meshes.push_back(meshOf(node));
+			lastChild.push_back(-1);
+			if (pending.parent >= 0)
+			{
+				int &last = lastChild[pending.parent];
+				if (last < 0)
+					table.firstChild[pending.parent] = i;
+				else
+					table.nextSibling[last] = i;
+				last = i;
+				table.childCount[pending.parent]++;
+			}
+			// pushed last to first so the first child is visited next
+			for (int c = node->GetChildCount() - 1; c >= 0; c--)
+			{
+				if (contains(node->GetChild(c)))
+					stack.push_back(Pending{node->GetChild(c), i});
+			}
+		}
+	}
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <fbxsdk.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "./scene_writer.h"
+#include "./thread_pool.h"
+#include "./trace.h"
+
+// Serializes the meshes of a subtree on a thread pool ahead of the scene walk.
+// Each distinct FbxMesh is exported once into a fragment of the target
+// writer; the walk then splices the fragments back in scene order, so the
+// output matches a serial export byte for byte. At most two meshes per
+// thread are exported ahead of the walk, the largest of the first ones
+// first, so only their fragments are held besides those of meshes the walk
+// reaches again.
+class MeshExportQueue
+{
+public:
+	typedef std::function<void(SceneWriter &, FbxMesh *)> ExportMesh;
+
+	// `meshes` lists every mesh reference in the order the walk reaches them
+	MeshExportQueue(SceneWriter &w, ThreadPool &pool, const std::vector<FbxMesh *> &meshes, ExportMesh exportMesh)
+		: mWriter(w), mPool(pool), mExportMesh(exportMesh), mOrder(meshes), mNext(0), mSubmitted(0), mWritten(0),
+		  mWindow(2 * pool.size())
+	{
+		for (FbxMesh *mesh : meshes)
+		{
+			auto it = mIndex.find(mesh);
+			if (it != mIndex.end())
+			{
+				mJobs[it->second]->uses++;
+				continue;
+			}
+			mIndex[mesh] = mJobs.size();
+			mJobs.emplace_back(new Job(mesh));
+		}
+
+		std::vector<Job *> bySize;
+		for (size_t i = 0; i < std::min(mWindow, mJobs.size()); i++)
+			bySize.push_back(mJobs[i].get());
+		std::stable_sort(bySize.begin(), bySize.end(), [](const Job *a, const Job *b) {
+			return a->cost > b->cost;
+		});
+		for (Job *job : bySize)
+			submit(*job);
+		mSubmitted = bySize.size();
+	}
+	~MeshExportQueue()
+	{
+		// tasks reference the jobs, let them drain if the walk stopped early
+		for (size_t i = 0; i < mSubmitted; i++)
+			mPool.waitUntil([&]() { return mJobs[i]->done.load(); });
+	}
+
+	// Writes the next mesh in scene order, waiting for it if necessary.
+	void writeNext(SceneWriter &w)
+	{
+		size_t index = mIndex[mOrder[mNext++]];
+		Job &job = *mJobs[index];
+		{
+			TraceScope trace("export", "waitMesh", job.mesh->GetName());
+			mPool.waitUntil([&]() { return job.done.load(); });
+		}
+		{
+			TraceScope trace("export", "writeFragment", job.mesh->GetName());
+			w.writeFragment(*job.fragment);
+		}
+		if (--job.uses == 0)
+			job.fragment.reset();
+		// jobs are first written in the order they were created
+		if (index == mWritten)
+			mWritten++;
+		while (mSubmitted < mJobs.size() && mSubmitted - mWritten < mWindow)
+			submit(*mJobs[mSubmitted++]);
+	}
+
+private:
+	struct Job
+	{
+		explicit Job(FbxMesh *m) : mesh(m), done(false), uses(1)
+		{
+			cost = static_cast<size_t>(m->GetControlPointsCount()) + m->GetPolygonVertexCount();
+		}
+		FbxMesh *mesh;
+		std::unique_ptr<SceneWriter> fragment;
+		std::atomic<bool> done;
+		int uses;
+		size_t cost;
+	};
+
+	void submit(Job &job)
+	{
+		job.fragment = mWriter.createFragment();
+		Job *pJob = &job;
+		ExportMesh exportMesh = mExportMesh;
+		mPool.submit([pJob, exportMesh]() {
+			exportMesh(*pJob->fragment, pJob->mesh);
+			pJob->done = true;
+		});
+	}
+
+	SceneWriter &mWriter;
+	ThreadPool &mPool;
+	ExportMesh mExportMesh;
+	std::vector<FbxMesh *> mOrder;
+	std::unordered_map<FbxMesh *, size_t> mIndex;
+	std::vector<std::unique_ptr<Job>> mJobs;
+	size_t mNext;
+	// jobs [0, mSubmitted) were handed to the pool, [0, mWritten) written
+	size_t mSubmitted;
+	size_t mWritten;
+	size_t mWindow;
+};
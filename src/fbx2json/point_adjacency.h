@@ -0,0 +1,42 @@
+#pragma once
+#include <fbxsdk.h>
+#include <vector>
+
+// Reverse of the polygon vertex array in compressed sparse row form: the
+// polygon vertices using control point p are
+//   polygonVertices[offsets[p]] .. polygonVertices[offsets[p + 1] - 1]
+// in increasing order. Built with one counting sort.
+struct PointAdjacency
+{
+	// GetControlPointsCount() + 1 entries
+	std::vector<int> offsets;
+	std::vector<int> polygonVertices;
+
+	// Polygon vertices pointing outside the control points are left out.
+	static void build(FbxMesh *pMesh, PointAdjacency &adjacency)
+	{
+		build(pMesh->GetPolygonVertices(), pMesh->GetPolygonVertexCount(), pMesh->GetControlPointsCount(), adjacency);
+	}
+
+	// the same over any array of control point indices, e.g. triangle corners
+	static void build(const int *pPolygonVertices, int lCount, int lPointCount, PointAdjacency &adjacency)
+	{
+		std::vector<int> &offsets = adjacency.offsets;
+		offsets.assign(static_cast<size_t>(lPointCount) + 1, 0);
+		for (int i = 0; i < lCount; i++)
+		{
+			if (static_cast<unsigned>(pPolygonVertices[i]) < static_cast<unsigned>(lPointCount))
+				offsets[pPolygonVertices[i] + 1]++;
+		}
+		for (int p = 0; p < lPointCount; p++)
+			offsets[p + 1] += offsets[p];
+
+		std::vector<int> next(offsets.begin(), offsets.end() - 1);
+		adjacency.polygonVertices.resize(offsets.back());
+		for (int i = 0; i < lCount; i++)
+		{
+			if (static_cast<unsigned>(pPolygonVertices[i]) < static_cast<unsigned>(lPointCount))
+				adjacency.polygonVertices[next[pPolygonVertices[i]]++] = i;
+		}
+	}
+};
@@ -0,0 +1,195 @@
+#pragma once
+#include <fbxsdk.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "./layer_array.h"
+#include "./thread_pool.h"
+#include "./trace.h"
+
+// What is checked after an import.
+enum ValidationMode
+{
+	// trust the input
+	eValidateNone,
+	// SceneValidator, linear in the size of the meshes
+	eValidateFast,
+	// the SDK's FbxSceneCheckUtility, see CheckSceneIntegrity
+	eValidateFull,
+};
+
+inline bool ParseValidationMode(const std::string &name, ValidationMode &mode)
+{
+	if (name == "none") mode = eValidateNone;
+	else if (name == "fast") mode = eValidateFast;
+	else if (name == "full") mode = eValidateFull;
+	else return false;
+	return true;
+}
+
+// Cheap consistency checks of what the exporter reads: polygon vertices index
+// existing control points, layer elements have as many values as their
+// mapping mode asks for, and index arrays stay inside their direct arrays.
+// Every array is read once, meshes are checked in parallel.
+class SceneValidator
+{
+public:
+	// problems reported per mesh before the rest of it is skipped
+	static const size_t maxErrorsPerMesh = 8;
+
+	// Appends one message per problem to `errors`, returns whether there were none.
+	static bool validateScene(FbxScene *pScene, unsigned threads, std::vector<std::string> &errors)
+	{
+		std::vector<FbxMesh *> meshes;
+		std::unordered_set<FbxMesh *> seen;
+		std::vector<FbxNode *> stack(1, pScene->GetRootNode());
+		while (!stack.empty())
+		{
+			FbxNode *node = stack.back();
+			stack.pop_back();
+			FbxMesh *mesh = node->GetMesh();
+			if (mesh && seen.insert(mesh).second)
+				meshes.push_back(mesh);
+			for (int i = node->GetChildCount() - 1; i >= 0; i--)
+				stack.push_back(node->GetChild(i));
+		}
+
+		std::vector<std::vector<std::string>> meshErrors(meshes.size());
+		ThreadPool pool(threads);
+		pool.parallelFor(meshes.size(), 1, [&](size_t i) {
+			validateMesh(meshes[i], meshErrors[i]);
+		});
+		size_t before = errors.size();
+		for (auto &e : meshErrors)
+			errors.insert(errors.end(), e.begin(), e.end());
+		return errors.size() == before;
+	}
+
+	static bool validateMesh(FbxMesh *pMesh, std::vector<std::string> &errors)
+	{
+		TraceScope trace("validation", "validateMesh", pMesh->GetName());
+		Context ctx(pMesh, errors);
+		const int *vertices = pMesh->GetPolygonVertices();
+		for (int i = 0; i < ctx.polygonVertexCount && ctx.ok(); i++)
+		{
+			if (vertices[i] < 0 || vertices[i] >= ctx.controlPointCount)
+				ctx.fail("polygon vertex " + std::to_string(i) + " references control point " + std::to_string(vertices[i])
+					+ " of " + std::to_string(ctx.controlPointCount));
+		}
+		int covered = 0;
+		for (int i = 0; i < ctx.polygonCount && ctx.ok(); i++)
+		{
+			int size = pMesh->GetPolygonSize(i);
+			if (size < 0)
+				ctx.fail("polygon " + std::to_string(i) + " has negative size");
+			else
+				covered += size;
+		}
+		if (ctx.ok() && covered != ctx.polygonVertexCount)
+			ctx.fail("polygons cover " + std::to_string(covered) + " of " + std::to_string(ctx.polygonVertexCount) + " polygon vertices");
+
+		validateElements(ctx, "vertexColors", pMesh->GetElementVertexColorCount(),
+			[pMesh](int i) { return pMesh->GetElementVertexColor(i); });
+		validateElements(ctx, "uv", pMesh->GetElementUVCount(),
+			[pMesh](int i) { return pMesh->GetElementUV(i); });
+		validateElements(ctx, "normals", pMesh->GetElementNormalCount(),
+			[pMesh](int i) { return pMesh->GetElementNormal(i); });
+		validateElements(ctx, "tangents", pMesh->GetElementTangentCount(),
+			[pMesh](int i) { return pMesh->GetElementTangent(i); });
+		validateElements(ctx, "binormals", pMesh->GetElementBinormalCount(),
+			[pMesh](int i) { return pMesh->GetElementBinormal(i); });
+		validateElements(ctx, "smoothing", pMesh->GetElementSmoothingCount(),
+			[pMesh](int i) { return pMesh->GetElementSmoothing(i); });
+		// material indices point at the node's materials, not at a direct array
+		for (int i = 0; i < pMesh->GetElementMaterialCount() && ctx.ok(); i++)
+		{
+			FbxGeometryElementMaterial *elem = pMesh->GetElementMaterial(i);
+			int expected = ctx.expectedCount(elem->GetMappingMode());
+			if (expected >= 0 && elem->GetReferenceMode() != FbxLayerElement::eDirect)
+				validateIndices(ctx, "materials", elem->GetName(), elem->GetIndexArray(), expected, -1);
+		}
+		return errors.size() == ctx.start;
+	}
+
+private:
+	struct Context
+	{
+		Context(FbxMesh *pMesh, std::vector<std::string> &e)
+			: mesh(pMesh), errors(e), start(e.size())
+		{
+			controlPointCount = pMesh->GetControlPointsCount();
+			polygonCount = pMesh->GetPolygonCount();
+			polygonVertexCount = pMesh->GetPolygonVertexCount();
+		}
+
+		bool ok() const { return errors.size() - start < maxErrorsPerMesh; }
+		void fail(const std::string &message)
+		{
+			errors.push_back("mesh '" + std::string(mesh->GetName()) + "': " + message);
+		}
+		// values a layer element must provide, -1 when the mode is not checked
+		int expectedCount(FbxLayerElement::EMappingMode mode) const
+		{
+			switch (mode)
+			{
+			case FbxLayerElement::eByControlPoint: return controlPointCount;
+			case FbxLayerElement::eByPolygonVertex: return polygonVertexCount;
+			case FbxLayerElement::eByPolygon: return polygonCount;
+			case FbxLayerElement::eAllSame: return 1;
+			default: return -1;
+			}
+		}
+
+		FbxMesh *mesh;
+		std::vector<std::string> &errors;
+		size_t start;
+		int controlPointCount;
+		int polygonCount;
+		int polygonVertexCount;
+	};
+
+	template<class TGetElement>
+	static void validateElements(Context &ctx, const char *key, int count, TGetElement getElement)
+	{
+		for (int i = 0; i < count && ctx.ok(); i++)
+		{
+			auto *elem = getElement(i);
+			int expected = ctx.expectedCount(elem->GetMappingMode());
+			if (expected < 0)
+				continue;
+			int directCount = elem->GetDirectArray().GetCount();
+			if (elem->GetReferenceMode() == FbxLayerElement::eDirect)
+			{
+				if (directCount < expected)
+					ctx.fail(std::string(key) + " '" + elem->GetName() + "' has " + std::to_string(directCount)
+						+ " values, its mapping mode needs " + std::to_string(expected));
+			}
+			else
+			{
+				validateIndices(ctx, key, elem->GetName(), elem->GetIndexArray(), expected, directCount);
+			}
+		}
+	}
+
+	// `directCount` -1 only checks for negative indices
+	static void validateIndices(Context &ctx, const char *key, const char *name, const FbxLayerElementArrayTemplate<int> &indexArray,
+		int expected, int directCount)
+	{
+		LayerArrayReader<int> indices(indexArray);
+		std::string what = std::string(key) + " '" + name + "'";
+		if (indices.count() < expected)
+		{
+			ctx.fail(what + " has " + std::to_string(indices.count()) + " indices, its mapping mode needs " + std::to_string(expected));
+			return;
+		}
+		const int *data = indices.data();
+		for (int i = 0; i < indices.count() && ctx.ok(); i++)
+		{
+			if (data[i] < 0)
+				ctx.fail(what + " index " + std::to_string(i) + " is negative");
+			else if (directCount >= 0 && data[i] >= directCount)
+				ctx.fail(what + " index " + std::to_string(i) + " is " + std::to_string(data[i])
+					+ ", past its " + std::to_string(directCount) + " values");
+		}
+	}
+};
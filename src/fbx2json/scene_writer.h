@@ -0,0 +1,279 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Buffered byte sink. Bytes are collected in memory and handed to the
+// std::ostream in large blocks; without a stream the buffer simply grows,
+// which is how in-memory fragments are produced.
+class OutputStream
+{
+public:
+	explicit OutputStream(std::ostream *out = nullptr, size_t capacity = 1 << 20)
+		: mOut(out), mCapacity(capacity), mFlushed(0), mSize(0)
+	{
+	}
+	~OutputStream() { flush(); }
+
+	void write(const char *data, size_t size)
+	{
+		// empty vectors hand in null
+		if (size == 0)
+			return;
+		if (mOut && mSize + size > mCapacity)
+		{
+			flush();
+			if (size >= mCapacity)
+			{
+				mOut->write(data, size);
+				mFlushed += size;
+				return;
+			}
+		}
+		std::memcpy(room(size), data, size);
+		mSize += size;
+	}
+	void write(const std::string &s) { write(s.data(), s.size()); }
+	void put(char c)
+	{
+		if (mOut && mSize >= mCapacity)
+			flush();
+		*room(1) = c;
+		mSize++;
+	}
+	// Room for up to `size` bytes to be written in place, e.g. by a number
+	// formatter; commit() keeps the bytes up to `end`.
+	char *reserve(size_t size)
+	{
+		if (mOut && mSize + size > mCapacity)
+			flush();
+		return room(size);
+	}
+	void commit(const char *end) { mSize = end - mBuffer.data(); }
+	void flush()
+	{
+		if (mOut && mSize != 0)
+		{
+			mOut->write(mBuffer.data(), mSize);
+			mFlushed += mSize;
+			mSize = 0;
+		}
+	}
+	// total number of bytes written so far, flushed or not
+	size_t tell() const { return mFlushed + mSize; }
+	bool good() const { return mOut == nullptr || mOut->good(); }
+	// buffered contents; holds everything when there is no stream
+	const char *data() const { return mBuffer.data(); }
+	size_t size() const { return mSize; }
+	std::string str() const { return std::string(mBuffer.data(), mSize); }
+
+private:
+	// the storage after the buffered bytes, grown to hold at least `size`
+	char *room(size_t size)
+	{
+		if (mSize + size > mBuffer.size())
+			mBuffer.resize(std::max(std::max(mBuffer.size() * 2, mSize + size), size_t(4096)));
+		return mBuffer.data() + mSize;
+	}
+
+	std::ostream *mOut;
+	size_t mCapacity;
+	size_t mFlushed;
+	// bytes of mBuffer in use, the rest is spare room
+	size_t mSize;
+	std::vector<char> mBuffer;
+};
+
+// SAX-style event sink the exporter streams the scene into. Container sizes
+// are always known up front so length-prefixed encodings can use them.
+class SceneWriter
+{
+public:
+	virtual ~SceneWriter() {}
+
+	virtual void startObject(size_t elements) = 0;
+	virtual void endObject() = 0;
+	virtual void startArray(size_t elements) = 0;
+	virtual void endArray() = 0;
+	virtual void key(const std::string &name) = 0;
+
+	virtual void null() = 0;
+	virtual void boolean(bool value) = 0;
+	virtual void numberInteger(int64_t value) = 0;
+	virtual void numberFloat(double value) = 0;
+	virtual void string(const std::string &value) = 0;
+
+	// Bulk arrays of `count` tuples with `components` values each. Tuples are
+	// written as nested arrays unless there is a single component.
+	virtual void intArray(const int *data, size_t count, int components = 1)
+	{
+		startArray(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			startTuple(components);
+			for (int c = 0; c < components; c++)
+				numberInteger(data[i * components + c]);
+			endTuple(components);
+		}
+		endArray();
+	}
+	virtual void floatArray(const double *data, size_t count, int components = 1)
+	{
+		startArray(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			startTuple(components);
+			for (int c = 0; c < components; c++)
+				numberFloat(data[i * components + c]);
+			endTuple(components);
+		}
+		endArray();
+	}
+
+	// Polygons in FBX PolygonVertexIndex form, where the last vertex of each
+	// polygon is stored as ~index. Written as one array per polygon.
+	virtual void polygonArray(const int *data, size_t count, size_t polygonCount)
+	{
+		startArray(polygonCount);
+		size_t begin = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (data[i] >= 0)
+				continue;
+			startArray(i + 1 - begin);
+			for (; begin < i; begin++)
+				numberInteger(data[begin]);
+			numberInteger(~data[i]);
+			endArray();
+			begin = i + 1;
+		}
+		endArray();
+	}
+
+	// Subtrees can be serialized on another thread into a fragment and later
+	// spliced in place of a single value. Fragments must come from the writer
+	// they are written back into; by default they record the events and
+	// replay them.
+	virtual std::unique_ptr<SceneWriter> createFragment();
+	virtual void writeFragment(const SceneWriter &fragment);
+
+private:
+	void startTuple(int components)
+	{
+		if (components != 1)
+			startArray(components);
+	}
+	void endTuple(int components)
+	{
+		if (components != 1)
+			endArray();
+	}
+};
+
+// Records the event stream, bulk arrays included, so it can be replayed into
+// another writer later.
+class SceneRecorder : public SceneWriter
+{
+public:
+	void startObject(size_t elements) override { push(eStartObject, elements); }
+	void endObject() override { push(eEndObject); }
+	void startArray(size_t elements) override { push(eStartArray, elements); }
+	void endArray() override { push(eEndArray); }
+	void key(const std::string &name) override
+	{
+		push(eKey, mStrings.size());
+		mStrings.push_back(name);
+	}
+
+	void null() override { push(eNull); }
+	void boolean(bool value) override { push(eBoolean, value); }
+	void numberInteger(int64_t value) override { push(eInteger, value); }
+	void numberFloat(double value) override
+	{
+		push(eFloat, mFloats.size());
+		mFloats.push_back(value);
+	}
+	void string(const std::string &value) override
+	{
+		push(eString, mStrings.size());
+		mStrings.push_back(value);
+	}
+
+	void intArray(const int *data, size_t count, int components = 1) override
+	{
+		push(eIntArray, mInts.size(), count, components);
+		mInts.insert(mInts.end(), data, data + count * components);
+	}
+	void floatArray(const double *data, size_t count, int components = 1) override
+	{
+		push(eFloatArray, mFloats.size(), count, components);
+		mFloats.insert(mFloats.end(), data, data + count * components);
+	}
+	void polygonArray(const int *data, size_t count, size_t polygonCount) override
+	{
+		push(ePolygonArray, mInts.size(), count, polygonCount);
+		mInts.insert(mInts.end(), data, data + count);
+	}
+
+	void replay(SceneWriter &w) const
+	{
+		for (const Event &e : mEvents)
+		{
+			switch (e.type)
+			{
+			case eStartObject: w.startObject(e.a); break;
+			case eEndObject: w.endObject(); break;
+			case eStartArray: w.startArray(e.a); break;
+			case eEndArray: w.endArray(); break;
+			case eKey: w.key(mStrings[e.a]); break;
+			case eNull: w.null(); break;
+			case eBoolean: w.boolean(e.a != 0); break;
+			case eInteger: w.numberInteger(e.a); break;
+			case eFloat: w.numberFloat(mFloats[e.a]); break;
+			case eString: w.string(mStrings[e.a]); break;
+			case eIntArray: w.intArray(mInts.data() + e.a, e.b, static_cast<int>(e.c)); break;
+			case eFloatArray: w.floatArray(mFloats.data() + e.a, e.b, static_cast<int>(e.c)); break;
+			case ePolygonArray: w.polygonArray(mInts.data() + e.a, e.b, e.c); break;
+			}
+		}
+	}
+
+private:
+	enum EventType
+	{
+		eStartObject, eEndObject, eStartArray, eEndArray, eKey,
+		eNull, eBoolean, eInteger, eFloat, eString,
+		eIntArray, eFloatArray, ePolygonArray,
+	};
+	struct Event
+	{
+		EventType type;
+		// payload or index into the side tables, depending on the type
+		int64_t a;
+		size_t b, c;
+	};
+	void push(EventType type, int64_t a = 0, size_t b = 0, size_t c = 0)
+	{
+		mEvents.push_back(Event{type, a, b, c});
+	}
+
+	std::vector<Event> mEvents;
+	std::vector<std::string> mStrings;
+	std::vector<int> mInts;
+	std::vector<double> mFloats;
+};
+
+inline std::unique_ptr<SceneWriter> SceneWriter::createFragment()
+{
+	return std::unique_ptr<SceneWriter>(new SceneRecorder());
+}
+
+inline void SceneWriter::writeFragment(const SceneWriter &fragment)
+{
+	static_cast<const SceneRecorder &>(fragment).replay(*this);
+}
@@ -0,0 +1,350 @@
+#include "./server.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <set>
+#ifdef _WIN32
+#include <io.h>
+#define dup _dup
+#define dup2 _dup2
+#define fdopen _fdopen
+#define fileno _fileno
+#else
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static void ApplyRequestOptions(const json &j, ConvertOptions &options)
+{
+    if (j.contains("binaryBuffers"))
+        options.binaryBuffers = j["binaryBuffers"].get<bool>();
+    if (j.contains("toc"))
+        options.toc = j["toc"].get<bool>();
+    if (j.contains("format"))
+    {
+        std::string format = j["format"].get<std::string>();
+        if (!ParseOutputFormat(format, options.format))
+            throw std::runtime_error("Unknown output format: " + format);
+    }
+    if (j.contains("float32"))
+        options.floatFormat.float32 = j["float32"].get<bool>();
+    if (j.contains("precision") && !ParsePrecision(j["precision"].get<int>(), options.floatFormat))
+        throw std::runtime_error("Precision must be between 0 and 17: " + std::to_string(j["precision"].get<int>()));
+    if (j.contains("allLayers"))
+        options.exportOptions.allLayers = j["allLayers"].get<bool>();
+    if (j.contains("pointAdjacency"))
+        options.exportOptions.pointAdjacency = j["pointAdjacency"].get<bool>();
+    if (j.contains("triangulate"))
+        options.exportOptions.triangulate = j["triangulate"].get<bool>();
+    if (j.contains("meshTable"))
+        options.exportOptions.meshTable = j["meshTable"].get<bool>();
+    if (j.contains("nodeTable"))
+        options.exportOptions.nodeTable = j["nodeTable"].get<bool>();
+    if (j.contains("dedupArrays"))
+        options.exportOptions.dedupArrays = j["dedupArrays"].get<bool>();
+    if (j.contains("threads"))
+        options.exportOptions.threads = j["threads"].get<unsigned>();
+    if (j.contains("include"))
+        options.exportOptions.filter.include = j["include"].get<std::vector<std::string>>();
+    if (j.contains("exclude"))
+        options.exportOptions.filter.exclude = j["exclude"].get<std::vector<std::string>>();
+    if (j.contains("types"))
+        options.exportOptions.filter.types = j["types"].get<std::vector<std::string>>();
+    if (j.contains("maxDepth"))
+        options.exportOptions.filter.maxDepth = j["maxDepth"].get<int>();
+    if (j.contains("importProfile"))
+    {
+        std::string profile = j["importProfile"].get<std::string>();
+        options.autoImportProfile = profile == "auto";
+        if (!options.autoImportProfile && !ParseImportProfile(profile.c_str(), options.importProfile))
+            throw std::runtime_error("Unknown import profile: " + profile);
+    }
+    if (j.contains("stats"))
+        options.collectStats = j["stats"].get<bool>();
+    if (j.contains("validate"))
+    {
+        std::string validate = j["validate"].get<std::string>();
+        if (!ParseValidationMode(validate, options.validation))
+            throw std::runtime_error("Unknown validation mode: " + validate);
+    }
+    if (j.contains("polygonLayout"))
+    {
+        std::string layout = j["polygonLayout"].get<std::string>();
+        if (layout == "csr")
+            options.exportOptions.polygonLayout = ExportOptions::eCsrPolygons;
+        else if (layout == "nested")
+            options.exportOptions.polygonLayout = ExportOptions::eNestedPolygons;
+        else
+            throw std::runtime_error("Unknown polygon layout: " + layout);
+    }
+    if (j.contains("vertexBuffer"))
+    {
+        std::string layout = j["vertexBuffer"].get<std::string>();
+        if (!ParseVertexBufferLayout(layout, options.exportOptions.vertexBuffer))
+            throw std::runtime_error("Unknown vertex buffer layout: " + layout);
+    }
+}
+
+static std::string MakeReply(const json &id, bool success, const std::string &error, double queueSeconds, const ConvertResult *result = nullptr, bool withStats = false)
+{
+    json reply;
+    reply["id"] = id;
+    reply["success"] = success;
+    reply["error"] = error;
+    reply["queueSeconds"] = queueSeconds;
+    reply["seconds"] = result ? result->seconds : 0.0;
+    reply["importSeconds"] = result ? result->importSeconds : 0.0;
+    reply["validateSeconds"] = result ? result->validateSeconds : 0.0;
+    if (result && withStats)
+        reply["stats"] = StatsToJson(result->stats);
+    // paths in errors need not be UTF-8
+    return reply.dump(-1, ' ', false, json::error_handler_t::replace);
+}
+
+ConversionService::ConversionService(const ConvertOptions &defaults, unsigned jobs)
+    : mDefaults(defaults), mStop(false)
+{
+    for (unsigned i = 0; i < std::max(1u, jobs); i++)
+        mWorkers.emplace_back(&ConversionService::workerLoop, this);
+}
+
+ConversionService::~ConversionService()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mWake.notify_all();
+    for (auto &worker : mWorkers)
+        worker.join();
+}
+
+bool ConversionService::handle(const std::string &line, Reply reply)
+{
+    json id;
+    std::string input, output;
+    ConvertOptions options = mDefaults;
+    try
+    {
+        json request = json::parse(line);
+        if (request.contains("id"))
+            id = request["id"];
+        if (request.value("command", "") == "shutdown")
+        {
+            reply(MakeReply(id, true, "", 0));
+            return false;
+        }
+        input = request.at("input").get<std::string>();
+        if (request.contains("options"))
+            ApplyRequestOptions(request["options"], options);
+        output = request.contains("output") ? request["output"].get<std::string>() : DefaultOutputPath(input, options.format);
+    }
+    catch (const std::exception &e)
+    {
+        reply(MakeReply(id, false, e.what(), 0));
+        return true;
+    }
+
+    Clock::time_point queued = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQueue.push_back([=](FbxManager *pManager) {
+            double queueSeconds = std::chrono::duration<double>(Clock::now() - queued).count();
+            std::string text;
+            // anything escaping a worker would take the whole server down
+            try
+            {
+                ConvertResult result = ConvertFile(pManager, input, output, options);
+                text = MakeReply(id, result.success, result.error, queueSeconds, &result, options.collectStats);
+            }
+            catch (const std::exception &e)
+            {
+                text = MakeReply(id, false, e.what(), queueSeconds);
+            }
+            reply(text);
+        });
+    }
+    mWake.notify_one();
+    return true;
+}
+
+void ConversionService::workerLoop()
+{
+    FbxManager *pManager = nullptr;
+    InitializeSdkManager(pManager);
+    while (true)
+    {
+        std::function<void(FbxManager *)> job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait(lock, [this]() { return mStop || !mQueue.empty(); });
+            if (mQueue.empty())
+                break;
+            job = std::move(mQueue.front());
+            mQueue.pop_front();
+        }
+        job(pManager);
+    }
+    DestroySdkObjects(pManager, false);
+}
+
+int ServeStdio(const ConvertOptions &defaults, unsigned jobs)
+{
+    // keep the real stdout for replies and send everything else to stderr
+    fflush(stdout);
+    int replyFd = dup(fileno(stdout));
+    dup2(fileno(stderr), fileno(stdout));
+    FILE *replies = fdopen(replyFd, "w");
+    if (replies == nullptr)
+    {
+        std::cerr << "Cannot open the reply stream" << std::endl;
+        return 1;
+    }
+
+    std::mutex replyMutex;
+    {
+        ConversionService service(defaults, jobs);
+        std::string line;
+        while (std::getline(std::cin, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line.empty())
+                continue;
+            bool more = service.handle(line, [&](const std::string &reply) {
+                std::lock_guard<std::mutex> lock(replyMutex);
+                fputs(reply.c_str(), replies);
+                fputc('\n', replies);
+                fflush(replies);
+            });
+            if (!more)
+                break;
+        }
+    }
+    fclose(replies);
+    return 0;
+}
+
+#ifdef _WIN32
+int ServeSocket(const std::string &, const ConvertOptions &, unsigned)
+{
+    std::cerr << "Unix domain sockets are not supported on this platform, use --serve without a socket" << std::endl;
+    return 1;
+}
+#else
+namespace
+{
+    // closed once the reader and all pending replies let go of it
+    struct Connection
+    {
+        explicit Connection(int f) : fd(f) {}
+        ~Connection() { close(fd); }
+        void send(const std::string &reply)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::string data = reply + "\n";
+            for (size_t sent = 0; sent < data.size();)
+            {
+                ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, 0);
+                if (n <= 0)
+                    return;
+                sent += n;
+            }
+        }
+        int fd;
+        std::mutex mutex;
+    };
+}
+
+int ServeSocket(const std::string &path, const ConvertOptions &defaults, unsigned jobs)
+{
+    // a client hanging up must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return 1;
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listenFd, 16) != 0)
+    {
+        std::cerr << "Cannot listen on " << path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    std::cout << "Listening on " << path << std::endl;
+
+    std::atomic<bool> stop(false);
+    // one per running reader, readers are detached and drop theirs when done
+    std::mutex connectionsMutex;
+    std::condition_variable connectionClosed;
+    std::set<int> openConnections;
+    {
+        ConversionService service(defaults, jobs);
+        while (!stop)
+        {
+            int clientFd = accept(listenFd, nullptr, nullptr);
+            if (clientFd < 0)
+            {
+                if (errno == EINTR && !stop)
+                    continue;
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(connectionsMutex);
+                openConnections.insert(clientFd);
+            }
+            std::shared_ptr<Connection> connection(new Connection(clientFd));
+            std::thread([&, connection]() {
+                std::string pending;
+                char buf[4096];
+                ssize_t n;
+                while ((n = recv(connection->fd, buf, sizeof(buf), 0)) > 0)
+                {
+                    pending.append(buf, n);
+                    size_t nl;
+                    while ((nl = pending.find('\n')) != std::string::npos)
+                    {
+                        std::string line = pending.substr(0, nl);
+                        pending.erase(0, nl + 1);
+                        if (!line.empty() && line.back() == '\r')
+                            line.pop_back();
+                        if (line.empty())
+                            continue;
+                        std::shared_ptr<Connection> replyTo = connection;
+                        if (!service.handle(line, [replyTo](const std::string &reply) { replyTo->send(reply); }))
+                        {
+                            // wake accept() and every other reader
+                            stop = true;
+                            shutdown(listenFd, SHUT_RDWR);
+                            std::lock_guard<std::mutex> lock(connectionsMutex);
+                            for (int fd : openConnections)
+                                shutdown(fd, SHUT_RD);
+                        }
+                    }
+                }
+                std::lock_guard<std::mutex> lock(connectionsMutex);
+                openConnections.erase(connection->fd);
+                connectionClosed.notify_all();
+            }).detach();
+        }
+        std::unique_lock<std::mutex> lock(connectionsMutex);
+        connectionClosed.wait(lock, [&]() { return openConnections.empty(); });
+    }
+    close(listenFd);
+    unlink(path.c_str());
+    return 0;
+}
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "./converter.h"
+
+// Conversion requests are newline-delimited JSON objects:
+//   {"id": 1, "input": "a.fbx", "output": "a.json",
+//    "options": {"format": "json", "binaryBuffers": true, "toc": true, "precision": 7, "float32": false,
+//                "polygonLayout": "csr", "vertexBuffer": "interleaved", "allLayers": true, "pointAdjacency": true,
+//                "triangulate": true, "meshTable": true, "nodeTable": true, "dedupArrays": true, "threads": 4,
+//                "include": ["**/UCX_*"], "exclude": [], "types": ["mesh"], "maxDepth": 3,
+//                "importProfile": "auto", "validate": "fast", "stats": true}}
+// Options default to the ones given on the command line. Every request gets
+// one reply line:
+//   {"id": 1, "success": true, "error": "", "queueSeconds": 0.01, "seconds": 0.2, "importSeconds": 0.1,
+//    "validateSeconds": 0.01, "stats": {...}}
+// stats is only present when requested and holds the phases, byte counts and
+// meshes that --stats reports.
+// {"command": "shutdown"} stops the server once pending requests are done.
+class ConversionService
+{
+public:
+	typedef std::function<void(const std::string &reply)> Reply;
+
+	// `jobs` workers, each keeping its own FbxManager warm
+	ConversionService(const ConvertOptions &defaults, unsigned jobs);
+	// waits for queued requests
+	~ConversionService();
+
+	// Parses and queues one request line; malformed requests are answered
+	// right away. Returns false once a shutdown was requested.
+	bool handle(const std::string &line, Reply reply);
+
+private:
+	void workerLoop();
+
+	ConvertOptions mDefaults;
+	std::vector<std::thread> mWorkers;
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::deque<std::function<void(FbxManager *)>> mQueue;
+	bool mStop;
+};
+
+// Serves requests read from stdin and answers on stdout until EOF. SDK log
+// output is moved to stderr so stdout only carries replies.
+int ServeStdio(const ConvertOptions &defaults, unsigned jobs);
+
+// Serves requests on a Unix domain socket until a shutdown request.
+int ServeSocket(const std::string &path, const ConvertOptions &defaults, unsigned jobs);
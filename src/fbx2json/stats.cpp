@@ -0,0 +1,94 @@
+#include "./stats.h"
+#include <algorithm>
+#ifdef _WIN32
+#define NOMINMAX
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+ProcessUsage ProcessUsage::now()
+{
+    ProcessUsage usage;
+#ifdef _WIN32
+    FILETIME creation, exited, kernel, user;
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exited, &kernel, &user))
+    {
+        auto seconds = [](const FILETIME &t) {
+            return ((uint64_t(t.dwHighDateTime) << 32) | t.dwLowDateTime) * 1e-7;
+        };
+        usage.cpuSeconds = seconds(kernel) + seconds(user);
+    }
+    PROCESS_MEMORY_COUNTERS memory;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory)))
+        usage.peakRssBytes = memory.PeakWorkingSetSize;
+#else
+    rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+    {
+        usage.cpuSeconds = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+#ifdef __APPLE__
+        usage.peakRssBytes = uint64_t(ru.ru_maxrss);
+#else
+        usage.peakRssBytes = uint64_t(ru.ru_maxrss) * 1024;
+#endif
+    }
+#endif
+    return usage;
+}
+
+json StatsToJson(const ConvertStats &stats)
+{
+    json j;
+    j["phases"] = json::array();
+    uint64_t peakRss = 0;
+    for (const PhaseStats &phase : stats.phases)
+    {
+        json p;
+        p["name"] = phase.name;
+        p["wallSeconds"] = phase.wallSeconds;
+        p["cpuSeconds"] = phase.cpuSeconds;
+        p["peakRssBytes"] = phase.peakRssBytes;
+        j["phases"].push_back(p);
+        peakRss = std::max(peakRss, phase.peakRssBytes);
+    }
+    j["peakRssBytes"] = peakRss;
+    j["jsonBytes"] = stats.jsonBytes;
+    j["binBytes"] = stats.binBytes;
+    j["tocBytes"] = stats.tocBytes;
+    j["dedup"] = {
+        {"arrays", stats.dedup.arrays},
+        {"sharedArrays", stats.dedup.sharedArrays},
+        {"references", stats.dedup.references},
+        {"bytesSaved", stats.dedup.bytesSaved},
+    };
+
+    std::vector<MeshStats> meshes = stats.meshes.meshes();
+    std::stable_sort(meshes.begin(), meshes.end(), [](const MeshStats &a, const MeshStats &b) {
+        return a.exportSeconds > b.exportSeconds;
+    });
+    j["meshes"] = json::array();
+    for (const MeshStats &mesh : meshes)
+    {
+        json m;
+        m["name"] = mesh.name;
+        m["exportSeconds"] = mesh.exportSeconds;
+        m["controlPoints"] = mesh.controlPoints;
+        m["polygons"] = mesh.polygons;
+        m["polygonVertices"] = mesh.polygonVertices;
+        m["vertexBufferVertices"] = mesh.vertexBufferVertices;
+        m["layerElements"] = {
+            {"vertexColors", mesh.vertexColors},
+            {"uv", mesh.uv},
+            {"normals", mesh.normals},
+            {"tangents", mesh.tangents},
+            {"binormals", mesh.binormals},
+            {"smoothing", mesh.smoothing},
+            {"materials", mesh.materials},
+        };
+        j["meshes"].push_back(m);
+    }
+    return j;
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <fbxsdk.h>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "./json_writer.h"
+
+// Process-wide counters at one point in time.
+struct ProcessUsage
+{
+	// user plus system time of all threads
+	double cpuSeconds = 0;
+	// high-water mark of the resident set so far
+	uint64_t peakRssBytes = 0;
+
+	static ProcessUsage now();
+};
+
+struct PhaseStats
+{
+	std::string name;
+	double wallSeconds = 0;
+	double cpuSeconds = 0;
+	uint64_t peakRssBytes = 0;
+};
+
+// Measures one phase from construction to stop(). CPU time is process-wide,
+// so it includes every pool thread but also other conversions running at
+// the same time.
+class PhaseTimer
+{
+public:
+	PhaseTimer() : mWallStart(std::chrono::steady_clock::now()), mStart(ProcessUsage::now()) {}
+
+	PhaseStats stop(const char *name) const
+	{
+		ProcessUsage end = ProcessUsage::now();
+		PhaseStats phase;
+		phase.name = name;
+		phase.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - mWallStart).count();
+		phase.cpuSeconds = end.cpuSeconds - mStart.cpuSeconds;
+		phase.peakRssBytes = end.peakRssBytes;
+		return phase;
+	}
+
+private:
+	std::chrono::steady_clock::time_point mWallStart;
+	ProcessUsage mStart;
+};
+
+struct MeshStats
+{
+	std::string name;
+	int controlPoints = 0;
+	int polygons = 0;
+	int polygonVertices = 0;
+	int vertexColors = 0;
+	int uv = 0;
+	int normals = 0;
+	int tangents = 0;
+	int binormals = 0;
+	int smoothing = 0;
+	int materials = 0;
+	// welded vertex buffer size, 0 when none was exported
+	int vertexBufferVertices = 0;
+	double exportSeconds = 0;
+};
+
+// Collects one entry per exportMesh call; safe to share between the threads
+// of a parallel export.
+class ExportStats
+{
+public:
+	ExportStats() {}
+	ExportStats(const ExportStats &other) : mMeshes(other.meshes()) {}
+	ExportStats &operator=(const ExportStats &other)
+	{
+		std::vector<MeshStats> meshes = other.meshes();
+		std::lock_guard<std::mutex> lock(mMutex);
+		mMeshes.swap(meshes);
+		return *this;
+	}
+
+	void addMesh(FbxMesh *pMesh, double seconds, int vertexBufferVertices = 0)
+	{
+		MeshStats mesh;
+		mesh.name = pMesh->GetName();
+		mesh.controlPoints = pMesh->GetControlPointsCount();
+		mesh.polygons = pMesh->GetPolygonCount();
+		mesh.polygonVertices = pMesh->GetPolygonVertexCount();
+		mesh.vertexColors = pMesh->GetElementVertexColorCount();
+		mesh.uv = pMesh->GetElementUVCount();
+		mesh.normals = pMesh->GetElementNormalCount();
+		mesh.tangents = pMesh->GetElementTangentCount();
+		mesh.binormals = pMesh->GetElementBinormalCount();
+		mesh.smoothing = pMesh->GetElementSmoothingCount();
+		mesh.materials = pMesh->GetElementMaterialCount();
+		mesh.vertexBufferVertices = vertexBufferVertices;
+		mesh.exportSeconds = seconds;
+		std::lock_guard<std::mutex> lock(mMutex);
+		mMeshes.push_back(mesh);
+	}
+
+	std::vector<MeshStats> meshes() const
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mMeshes;
+	}
+
+private:
+	mutable std::mutex mMutex;
+	std::vector<MeshStats> mMeshes;
+};
+
+// What ExportOptions::dedupArrays found in one scene.
+struct DedupStats
+{
+	// bulk arrays written, counting every occurrence
+	size_t arrays = 0;
+	// entries of the shared array table
+	size_t sharedArrays = 0;
+	// occurrences replaced by a table reference
+	size_t references = 0;
+	// payload of the occurrences beyond the first of every shared array, the
+	// encoded size saved depends on the writer
+	uint64_t bytesSaved = 0;
+};
+
+// Everything --stats reports about one conversion.
+struct ConvertStats
+{
+	// init (when the manager was created for this file), import, validation,
+	// export (scene walk and serialization, full buffers are written as they
+	// fill) and write (final flush and close)
+	std::vector<PhaseStats> phases;
+	// the output file in its format, the companion .bin and .toc.json
+	uint64_t jsonBytes = 0;
+	uint64_t binBytes = 0;
+	uint64_t tocBytes = 0;
+	DedupStats dedup;
+	ExportStats meshes;
+};
+
+// slowest meshes first
+json StatsToJson(const ConvertStats &stats);
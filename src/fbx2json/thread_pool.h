@@ -0,0 +1,188 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small work-stealing pool. Every thread owns a deque: it takes work from the
+// front of its own deque and steals from the back of the others. Threads that
+// wait on a result keep running tasks, so tasks may submit and wait on
+// nested work without deadlocking.
+class ThreadPool
+{
+public:
+	typedef std::function<void()> Task;
+
+	// 0 picks the hardware concurrency; the calling thread counts as one
+	explicit ThreadPool(unsigned threads = 0)
+		: mStop(false), mPending(0), mNextQueue(0)
+	{
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		for (unsigned i = 0; i < threads; i++)
+			mQueues.emplace_back(new Queue());
+		// queue 0 is shared by the threads outside the pool
+		for (unsigned i = 1; i < threads; i++)
+			mWorkers.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mWakeMutex);
+			mStop = true;
+		}
+		mWake.notify_all();
+		for (auto &worker : mWorkers)
+			worker.join();
+	}
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	size_t size() const { return mQueues.size(); }
+
+	// Tasks submitted from outside the pool are dealt round-robin, so a list
+	// submitted in priority order is started in that order. Tasks submitted
+	// by a pool thread go to the front of its own deque.
+	void submit(Task task)
+	{
+		int self = currentIndex();
+		if (self >= 0)
+		{
+			Queue &q = *mQueues[self];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			q.tasks.push_front(std::move(task));
+		}
+		else
+		{
+			Queue &q = *mQueues[mNextQueue++ % mQueues.size()];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			q.tasks.push_back(std::move(task));
+		}
+		mPending++;
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mWake.notify_one();
+	}
+
+	// Runs one queued task on the calling thread, if there is any.
+	bool runOne()
+	{
+		Task task;
+		if (!take(task))
+			return false;
+		task();
+		return true;
+	}
+
+	// Helps with queued work until `done` returns true.
+	template <class Pred>
+	void waitUntil(Pred done)
+	{
+		while (!done())
+		{
+			if (!runOne())
+				std::this_thread::yield();
+		}
+	}
+
+	// Calls fn(i) for every i in [0, count), `grain` indices per task, and
+	// returns once all of them finished.
+	template <class Fn>
+	void parallelFor(size_t count, size_t grain, Fn fn)
+	{
+		if (count == 0)
+			return;
+		grain = std::max<size_t>(1, grain);
+		size_t chunks = (count + grain - 1) / grain;
+		if (chunks == 1 || size() == 1)
+		{
+			for (size_t i = 0; i < count; i++)
+				fn(i);
+			return;
+		}
+		auto remaining = std::make_shared<std::atomic<size_t>>(chunks);
+		for (size_t c = 0; c < chunks; c++)
+		{
+			size_t begin = c * grain;
+			size_t end = std::min(count, begin + grain);
+			submit([=, &fn]() {
+				for (size_t i = begin; i < end; i++)
+					fn(i);
+				(*remaining)--;
+			});
+		}
+		waitUntil([&]() { return *remaining == 0; });
+	}
+
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	bool take(Task &task)
+	{
+		int self = currentIndex();
+		size_t first = self >= 0 ? self : 0;
+		for (size_t n = 0; n < mQueues.size(); n++)
+		{
+			size_t i = (first + n) % mQueues.size();
+			Queue &q = *mQueues[i];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			if (q.tasks.empty())
+				continue;
+			if (n == 0)
+			{
+				task = std::move(q.tasks.front());
+				q.tasks.pop_front();
+			}
+			else
+			{
+				task = std::move(q.tasks.back());
+				q.tasks.pop_back();
+			}
+			mPending--;
+			return true;
+		}
+		return false;
+	}
+
+	void workerLoop(int index)
+	{
+		current() = std::make_pair(this, index);
+		while (true)
+		{
+			if (runOne())
+				continue;
+			std::unique_lock<std::mutex> lock(mWakeMutex);
+			mWake.wait(lock, [this]() { return mStop || mPending > 0; });
+			if (mStop)
+				return;
+		}
+	}
+
+	// index of the calling thread in this pool, -1 outside of it
+	int currentIndex() const
+	{
+		const auto &c = current();
+		return c.first == this ? c.second : -1;
+	}
+	static std::pair<const ThreadPool *, int> &current()
+	{
+		static thread_local std::pair<const ThreadPool *, int> c(nullptr, -1);
+		return c;
+	}
+
+	std::vector<std::unique_ptr<Queue>> mQueues;
+	std::vector<std::thread> mWorkers;
+	std::mutex mWakeMutex;
+	std::condition_variable mWake;
+	bool mStop;
+	std::atomic<int> mPending;
+	std::atomic<size_t> mNextQueue;
+};
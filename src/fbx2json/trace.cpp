@@ -0,0 +1,65 @@
+#include "./trace.h"
+#include <fstream>
+#include "./json_writer.h"
+
+void Trace::start()
+{
+    Trace &trace = instance();
+    std::lock_guard<std::mutex> lock(trace.mMutex);
+    trace.mThreads.clear();
+    trace.mGeneration++;
+    trace.mStart = std::chrono::steady_clock::now();
+    trace.mEnabled = true;
+}
+
+void Trace::record(Event &&event)
+{
+    instance().threadBuffer().events.push_back(std::move(event));
+}
+
+Trace::ThreadBuffer &Trace::threadBuffer()
+{
+    thread_local ThreadBuffer *tBuffer = nullptr;
+    thread_local unsigned tGeneration = 0;
+    unsigned generation = mGeneration.load();
+    if (tBuffer == nullptr || tGeneration != generation)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mThreads.emplace_back(new ThreadBuffer());
+        tBuffer = mThreads.back().get();
+        tBuffer->tid = int(mThreads.size());
+        tGeneration = generation;
+    }
+    return *tBuffer;
+}
+
+bool Trace::write(const std::string &path)
+{
+    Trace &trace = instance();
+    trace.mEnabled = false;
+    std::lock_guard<std::mutex> lock(trace.mMutex);
+    json events = json::array();
+    for (const auto &thread : trace.mThreads)
+    {
+        for (const Event &e : thread->events)
+        {
+            json event;
+            event["name"] = e.name;
+            event["cat"] = e.category;
+            event["ph"] = "X";
+            event["ts"] = e.begin;
+            event["dur"] = e.duration;
+            event["pid"] = 1;
+            event["tid"] = thread->tid;
+            if (!e.detail.empty())
+                event["args"] = {{"detail", e.detail}};
+            events.push_back(event);
+        }
+    }
+    json root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+    std::ofstream out(path);
+    out << root.dump() << std::endl;
+    return out.good();
+}
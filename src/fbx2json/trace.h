@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Chrome trace-event recorder (chrome://tracing, ui.perfetto.dev). Spans are
+// kept in per-thread buffers and only serialized by write(). While tracing
+// is off a TraceScope costs one relaxed atomic load.
+class Trace
+{
+public:
+	struct Event
+	{
+		const char *category = nullptr;
+		const char *name = nullptr;
+		std::string detail;
+		// microseconds since start()
+		double begin = 0;
+		double duration = 0;
+	};
+
+	static bool enabled() { return instance().mEnabled.load(std::memory_order_relaxed); }
+
+	// drops anything recorded before and starts recording
+	static void start();
+	// Stops recording and writes {"traceEvents": [...]}, false on I/O errors.
+	// Call once the traced work is done, buffers are not locked while recording.
+	static bool write(const std::string &path);
+
+	static double now()
+	{
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - instance().mStart).count();
+	}
+	static void record(Event &&event);
+
+private:
+	struct ThreadBuffer
+	{
+		int tid;
+		std::vector<Event> events;
+	};
+
+	Trace() : mEnabled(false), mStart(std::chrono::steady_clock::now()), mGeneration(0) {}
+	static Trace &instance()
+	{
+		static Trace trace;
+		return trace;
+	}
+	ThreadBuffer &threadBuffer();
+
+	std::atomic<bool> mEnabled;
+	std::chrono::steady_clock::time_point mStart;
+	std::mutex mMutex;
+	// every thread that recorded since start(), in order of their first event
+	std::vector<std::unique_ptr<ThreadBuffer>> mThreads;
+	// bumped by start() so threads re-register their buffer
+	std::atomic<unsigned> mGeneration;
+};
+
+// One complete ("X") event from construction to destruction. `category` and
+// `name` must be string literals; `detail`, e.g. a mesh name, is copied into
+// the event's args only while tracing.
+class TraceScope
+{
+public:
+	TraceScope(const char *category, const char *name, const char *detail = nullptr)
+		: mActive(Trace::enabled())
+	{
+		if (!mActive)
+			return;
+		mEvent.category = category;
+		mEvent.name = name;
+		if (detail)
+			mEvent.detail = detail;
+		mEvent.begin = Trace::now();
+	}
+	~TraceScope()
+	{
+		if (!mActive)
+			return;
+		mEvent.duration = Trace::now() - mEvent.begin;
+		Trace::record(std::move(mEvent));
+	}
+	TraceScope(const TraceScope &) = delete;
+	TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+	bool mActive;
+	Trace::Event mEvent;
+};
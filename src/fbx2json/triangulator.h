@@ -0,0 +1,190 @@
+#pragma once
+#include <fbxsdk.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "./thread_pool.h"
+
+// Triangles of a mesh as references into its polygon vertices, so layer
+// elements can be remapped without rebuilding the mesh.
+struct Triangulation
+{
+	// 3 per triangle, polygon vertex indices of the source mesh
+	std::vector<int> corners;
+	// source polygon of every triangle
+	std::vector<int> polygons;
+
+	int triangleCount() const { return static_cast<int>(polygons.size()); }
+};
+
+// Fans convex polygons and ear-clips concave ones in the plane of their
+// Newell normal; both keep the winding of the source polygon. An n-gon
+// always yields n - 2 triangles, so polygon ranges are triangulated in
+// parallel into precomputed slots. Polygons with fewer than three vertices
+// are dropped. When no ear is found (self-intersecting or degenerate
+// polygons) the rest of the polygon is fanned.
+class Triangulator
+{
+public:
+	// polygons per parallel task
+	static const int grain = 16384;
+
+	static void build(FbxMesh *pMesh, Triangulation &triangulation, ThreadPool *pool = nullptr)
+	{
+		int lPolygonCount = pMesh->GetPolygonCount();
+		std::vector<int> starts(static_cast<size_t>(lPolygonCount) + 1);
+		std::vector<int> firstTriangle(static_cast<size_t>(lPolygonCount) + 1);
+		for (int p = 0; p < lPolygonCount; p++)
+		{
+			int lSize = pMesh->GetPolygonSize(p);
+			starts[p + 1] = starts[p] + lSize;
+			firstTriangle[p + 1] = firstTriangle[p] + std::max(0, lSize - 2);
+		}
+		triangulation.corners.resize(static_cast<size_t>(firstTriangle.back()) * 3);
+		triangulation.polygons.resize(firstTriangle.back());
+
+		const FbxVector4 *pControlPoints = pMesh->GetControlPoints();
+		const int *pPolygonVertices = pMesh->GetPolygonVertices();
+		int lPointCount = pMesh->GetControlPointsCount();
+		auto range = [&](size_t chunk) {
+			std::vector<int> scratch;
+			int lEnd = std::min(lPolygonCount, static_cast<int>(chunk + 1) * grain);
+			for (int p = static_cast<int>(chunk) * grain; p < lEnd; p++)
+			{
+				int lSize = starts[p + 1] - starts[p];
+				if (lSize < 3)
+					continue;
+				int *out = &triangulation.corners[static_cast<size_t>(firstTriangle[p]) * 3];
+				std::fill(triangulation.polygons.begin() + firstTriangle[p], triangulation.polygons.begin() + firstTriangle[p + 1], p);
+				triangulatePolygon(pControlPoints, lPointCount, pPolygonVertices + starts[p], starts[p], lSize, out, scratch);
+			}
+		};
+		size_t chunks = (static_cast<size_t>(lPolygonCount) + grain - 1) / grain;
+		if (pool && chunks > 1)
+			pool->parallelFor(chunks, 1, range);
+		else
+			for (size_t c = 0; c < chunks; c++)
+				range(c);
+	}
+
+private:
+	struct Point2
+	{
+		double x, y;
+	};
+
+	static double cross(const Point2 &a, const Point2 &b, const Point2 &c)
+	{
+		return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	}
+
+	// `vertices` are the control points of one polygon, `first` its first
+	// polygon vertex; writes size - 2 triangles of polygon vertex indices
+	static void triangulatePolygon(const FbxVector4 *pControlPoints, int lPointCount, const int *vertices, int first, int size,
+		int *out, std::vector<int> &scratch)
+	{
+		if (size == 3)
+		{
+			fan(first, 3, out);
+			return;
+		}
+		for (int i = 0; i < size; i++)
+		{
+			if (static_cast<unsigned>(vertices[i]) >= static_cast<unsigned>(lPointCount))
+			{
+				fan(first, size, out);
+				return;
+			}
+		}
+
+		// Newell normal, then drop its largest axis; the sign keeps the
+		// projected polygon counter-clockwise
+		double n[3] = {0, 0, 0};
+		for (int i = 0; i < size; i++)
+		{
+			const FbxVector4 &a = pControlPoints[vertices[i]];
+			const FbxVector4 &b = pControlPoints[vertices[(i + 1) % size]];
+			n[0] += (a[1] - b[1]) * (a[2] + b[2]);
+			n[1] += (a[2] - b[2]) * (a[0] + b[0]);
+			n[2] += (a[0] - b[0]) * (a[1] + b[1]);
+		}
+		int lDrop = std::fabs(n[0]) > std::fabs(n[1]) ? (std::fabs(n[0]) > std::fabs(n[2]) ? 0 : 2) : (std::fabs(n[1]) > std::fabs(n[2]) ? 1 : 2);
+		int u = (lDrop + 1) % 3, v = (lDrop + 2) % 3;
+		double lSign = n[lDrop] < 0 ? -1.0 : 1.0;
+		std::vector<Point2> points(size);
+		for (int i = 0; i < size; i++)
+		{
+			const FbxVector4 &c = pControlPoints[vertices[i]];
+			points[i] = Point2{c[u], lSign * c[v]};
+		}
+
+		bool convex = true;
+		for (int i = 0; i < size && convex; i++)
+			convex = cross(points[i], points[(i + 1) % size], points[(i + 2) % size]) >= 0;
+		if (convex)
+		{
+			fan(first, size, out);
+			return;
+		}
+
+		// remaining vertices as a cyclic list
+		scratch.resize(size);
+		for (int i = 0; i < size; i++)
+			scratch[i] = i;
+		int lRemaining = size;
+		int i = 0;
+		for (int lMisses = 0; lRemaining > 3 && lMisses < lRemaining;)
+		{
+			int a = scratch[(i + lRemaining - 1) % lRemaining], b = scratch[i % lRemaining], c = scratch[(i + 1) % lRemaining];
+			if (isEar(points, scratch, lRemaining, a, b, c))
+			{
+				*out++ = first + a;
+				*out++ = first + b;
+				*out++ = first + c;
+				scratch.erase(scratch.begin() + i % lRemaining);
+				lRemaining--;
+				lMisses = 0;
+				i %= lRemaining;
+			}
+			else
+			{
+				i = (i + 1) % lRemaining;
+				lMisses++;
+			}
+		}
+		// the last triangle, or a fan over what no ear could be cut from
+		for (int k = 1; k + 1 < lRemaining; k++)
+		{
+			*out++ = first + scratch[0];
+			*out++ = first + scratch[k];
+			*out++ = first + scratch[k + 1];
+		}
+	}
+
+	static bool isEar(const std::vector<Point2> &points, const std::vector<int> &remaining, int count, int a, int b, int c)
+	{
+		if (cross(points[a], points[b], points[c]) <= 0)
+			return false;
+		for (int k = 0; k < count; k++)
+		{
+			int p = remaining[k];
+			if (p == a || p == b || p == c)
+				continue;
+			if (cross(points[a], points[b], points[p]) >= 0 && cross(points[b], points[c], points[p]) >= 0 &&
+				cross(points[c], points[a], points[p]) >= 0)
+				return false;
+		}
+		return true;
+	}
+
+	// triangles (first, first + k, first + k + 1) for k in [1, size - 1)
+	static void fan(int first, int size, int *out)
+	{
+		for (int k = 1; k + 1 < size; k++)
+		{
+			*out++ = first;
+			*out++ = first + k;
+			*out++ = first + k + 1;
+		}
+	}
+};
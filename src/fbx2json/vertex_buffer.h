@@ -0,0 +1,134 @@
+#pragma once
+#include <fbxsdk.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "./array_dedup.h"
+#include "./layer_element.h"
+
+// Vertices welded from the polygon vertices of one mesh: every distinct
+// (position, normal, uv0..n, color0..n) tuple once, plus one index per
+// polygon vertex.
+struct VertexBuffer
+{
+	struct Attribute
+	{
+		std::string name;
+		int components;
+	};
+	std::vector<Attribute> attributes;
+	// components per vertex, the sum over the attributes
+	int stride = 0;
+	// vertexCount() * stride values, attributes interleaved
+	std::vector<double> vertices;
+	// GetPolygonVertexCount() entries
+	std::vector<int> indices;
+
+	int vertexCount() const { return stride ? static_cast<int>(vertices.size() / stride) : 0; }
+
+	// the values of one attribute for every vertex, for separate streams
+	std::vector<double> stream(size_t attribute) const
+	{
+		int offset = 0;
+		for (size_t a = 0; a < attribute; a++)
+			offset += attributes[a].components;
+		int components = attributes[attribute].components;
+		std::vector<double> values;
+		values.reserve(static_cast<size_t>(vertexCount()) * components);
+		for (size_t v = 0; v < vertices.size(); v += stride)
+			values.insert(values.end(), vertices.begin() + v + offset, vertices.begin() + v + offset + components);
+		return values;
+	}
+};
+
+// Builds a VertexBuffer with an open-addressing hash table over the vertex
+// tuples. Tuples are compared bit for bit, so -0.0 and 0.0 stay apart.
+class VertexWelder
+{
+public:
+	// Elements whose mapping cannot be resolved per polygon vertex are left
+	// out; the buffer stays empty when polygon vertices point outside the
+	// control points.
+	static void build(FbxMesh *pMesh, VertexBuffer &buffer)
+	{
+		buffer = VertexBuffer();
+		int lCount = pMesh->GetPolygonVertexCount();
+		const int *pPolygonVertices = pMesh->GetPolygonVertices();
+		const FbxVector4 *pControlPoints = pMesh->GetControlPoints();
+		for (int i = 0; i < lCount; i++)
+		{
+			if (static_cast<unsigned>(pPolygonVertices[i]) >= static_cast<unsigned>(pMesh->GetControlPointsCount()))
+				return;
+		}
+
+		std::vector<Source> sources;
+		buffer.attributes.push_back(VertexBuffer::Attribute{"position", 3});
+		std::vector<FbxVector4> normals;
+		if (ResolveLayerElement(pMesh, pMesh->GetElementNormal(0), LayerElementResolver<FbxVector4>::ePolygonVertex, normals))
+			addSource(buffer, sources, "normal", normals, 3);
+		std::vector<std::vector<FbxVector2>> uvs(pMesh->GetElementUVCount());
+		for (size_t k = 0; k < uvs.size(); k++)
+		{
+			if (ResolveLayerElement(pMesh, pMesh->GetElementUV(static_cast<int>(k)), LayerElementResolver<FbxVector2>::ePolygonVertex, uvs[k]))
+				addSource(buffer, sources, "uv" + std::to_string(k), uvs[k], 2);
+		}
+		std::vector<std::vector<FbxColor>> colors(pMesh->GetElementVertexColorCount());
+		for (size_t k = 0; k < colors.size(); k++)
+		{
+			if (ResolveLayerElement(pMesh, pMesh->GetElementVertexColor(static_cast<int>(k)), LayerElementResolver<FbxColor>::ePolygonVertex, colors[k]))
+				addSource(buffer, sources, "color" + std::to_string(k), colors[k], 4);
+		}
+		int stride = 3;
+		for (const Source &source : sources)
+			stride += source.components;
+		buffer.stride = stride;
+
+		// power of two at least twice the worst case, entries are vertex ids
+		size_t capacity = 16;
+		while (capacity < 2 * static_cast<size_t>(lCount))
+			capacity *= 2;
+		std::vector<int> table(capacity, -1);
+		buffer.indices.resize(lCount);
+		buffer.vertices.reserve(static_cast<size_t>(lCount) * stride);
+		std::vector<double> tuple(stride);
+		for (int i = 0; i < lCount; i++)
+		{
+			std::memcpy(tuple.data(), reinterpret_cast<const double *>(pControlPoints + pPolygonVertices[i]), 3 * sizeof(double));
+			double *out = tuple.data() + 3;
+			for (const Source &source : sources)
+			{
+				std::memcpy(out, source.data + static_cast<size_t>(i) * source.tupleSize, source.components * sizeof(double));
+				out += source.components;
+			}
+
+			size_t bytes = stride * sizeof(double);
+			size_t slot = static_cast<size_t>(ArrayHash::of(tuple.data(), bytes).low) & (capacity - 1);
+			while (table[slot] >= 0 && std::memcmp(&buffer.vertices[static_cast<size_t>(table[slot]) * stride], tuple.data(), bytes) != 0)
+				slot = (slot + 1) & (capacity - 1);
+			if (table[slot] < 0)
+			{
+				table[slot] = buffer.vertexCount();
+				buffer.vertices.insert(buffer.vertices.end(), tuple.begin(), tuple.end());
+			}
+			buffer.indices[i] = table[slot];
+		}
+		buffer.vertices.shrink_to_fit();
+	}
+
+private:
+	// resolved per polygon vertex values of one element
+	struct Source
+	{
+		const double *data;
+		// doubles per element value, of which the first `components` are used
+		int tupleSize;
+		int components;
+	};
+
+	template <class T>
+	static void addSource(VertexBuffer &buffer, std::vector<Source> &sources, const std::string &name, const std::vector<T> &values, int components)
+	{
+		buffer.attributes.push_back(VertexBuffer::Attribute{name, components});
+		sources.push_back(Source{reinterpret_cast<const double *>(values.data()), LayerArrayTraits<T>::components, components});
+	}
+};
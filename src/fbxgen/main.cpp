@@ -0,0 +1,73 @@
+#include "./scene_generator.h"
+#include "fbx_common.h"
+#include <cxxopts.hpp>
+#include <iostream>
+#include <string>
+typedef cxxopts::Options CmdOptions;
+
+int main(int argc, char **argv)
+{
+    CmdOptions options(argv[0], " - synthetic FBX scene generator");
+    options.add_options()
+        ("help,h", "Print help")
+        ("output,o", "Output FBX file", cxxopts::value<std::string>())
+        ("seed", "Random seed, the same seed and options give the same file", cxxopts::value<uint64_t>()->default_value("1"))
+        ("meshes", "Number of distinct meshes", cxxopts::value<int>()->default_value("1"))
+        ("vertices", "Control points per mesh", cxxopts::value<int>()->default_value("1024"))
+        ("uv", "UV channels per mesh", cxxopts::value<int>()->default_value("1"))
+        ("colors", "Vertex color sets per mesh", cxxopts::value<int>()->default_value("0"))
+        ("no-normals", "Do not add normals")
+        ("min-polygon", "Smallest polygon size", cxxopts::value<int>()->default_value("4"))
+        ("max-polygon", "Largest polygon size", cxxopts::value<int>()->default_value("4"))
+        ("uv-mapping", "controlPoint, polygonVertex, polygon or allSame", cxxopts::value<std::string>()->default_value("polygonVertex"))
+        ("uv-reference", "direct or indexToDirect", cxxopts::value<std::string>()->default_value("indexToDirect"))
+        ("color-mapping", "controlPoint, polygonVertex, polygon or allSame", cxxopts::value<std::string>()->default_value("controlPoint"))
+        ("color-reference", "direct or indexToDirect", cxxopts::value<std::string>()->default_value("direct"))
+        ("hierarchy", "Node layout: wide, deep or balanced", cxxopts::value<std::string>()->default_value("wide"))
+        ("instances", "Nodes sharing each mesh", cxxopts::value<int>()->default_value("1"))
+        ("ascii", "Write ASCII FBX instead of binary");
+
+    auto result = options.parse(argc, argv);
+    if (result.count("help"))
+    {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+    if (result.count("output") == 0)
+    {
+        std::cout << "Output file is required" << std::endl;
+        return 1;
+    }
+
+    GeneratorOptions generatorOptions;
+    generatorOptions.seed = result["seed"].as<uint64_t>();
+    generatorOptions.meshes = std::max(1, result["meshes"].as<int>());
+    generatorOptions.vertices = result["vertices"].as<int>();
+    generatorOptions.uvSets = result["uv"].as<int>();
+    generatorOptions.colorSets = result["colors"].as<int>();
+    generatorOptions.normals = result.count("no-normals") == 0;
+    generatorOptions.minPolygonSize = result["min-polygon"].as<int>();
+    generatorOptions.maxPolygonSize = result["max-polygon"].as<int>();
+    generatorOptions.instances = result["instances"].as<int>();
+    bool valid = ParseMappingMode(result["uv-mapping"].as<std::string>(), generatorOptions.uvMapping)
+        && ParseReferenceMode(result["uv-reference"].as<std::string>(), generatorOptions.uvReference)
+        && ParseMappingMode(result["color-mapping"].as<std::string>(), generatorOptions.colorMapping)
+        && ParseReferenceMode(result["color-reference"].as<std::string>(), generatorOptions.colorReference)
+        && ParseHierarchy(result["hierarchy"].as<std::string>(), generatorOptions.hierarchy);
+    if (!valid)
+    {
+        std::cout << "Unknown mapping mode, reference mode or hierarchy, see --help" << std::endl;
+        return 1;
+    }
+
+    FbxManager *pManager = nullptr;
+    InitializeSdkManager(pManager);
+    FbxScene *pScene = SceneGenerator(generatorOptions).generate(pManager);
+
+    int fileFormat = -1;
+    if (result.count("ascii"))
+        fileFormat = pManager->GetIOPluginRegistry()->FindWriterIDByDescription("FBX ascii (*.fbx)");
+    bool saved = SaveScene(pManager, pScene, result["output"].as<std::string>().c_str(), -1, fileFormat);
+    DestroySdkObjects(pManager, saved);
+    return saved ? 0 : 1;
+}
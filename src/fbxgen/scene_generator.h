@@ -0,0 +1,227 @@
+#pragma once
+#include <fbxsdk.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Shape of a generated scene. The same options and seed always produce the
+// same scene, on every platform.
+struct GeneratorOptions
+{
+	enum Hierarchy
+	{
+		// every node is a child of the root
+		eWide,
+		// every node is a child of the previous one
+		eDeep,
+		// binary tree in breadth-first order
+		eBalanced,
+	};
+
+	uint64_t seed = 1;
+	// distinct meshes
+	int meshes = 1;
+	// control points per mesh
+	int vertices = 1024;
+	int uvSets = 1;
+	int colorSets = 0;
+	bool normals = true;
+	// polygon sizes are drawn from [minPolygonSize, maxPolygonSize]
+	int minPolygonSize = 4;
+	int maxPolygonSize = 4;
+	FbxLayerElement::EMappingMode uvMapping = FbxLayerElement::eByPolygonVertex;
+	FbxLayerElement::EReferenceMode uvReference = FbxLayerElement::eIndexToDirect;
+	FbxLayerElement::EMappingMode colorMapping = FbxLayerElement::eByControlPoint;
+	FbxLayerElement::EReferenceMode colorReference = FbxLayerElement::eDirect;
+	Hierarchy hierarchy = eWide;
+	// nodes referencing each mesh
+	int instances = 1;
+};
+
+inline bool ParseMappingMode(const std::string &name, FbxLayerElement::EMappingMode &mode)
+{
+	if (name == "controlPoint") mode = FbxLayerElement::eByControlPoint;
+	else if (name == "polygonVertex") mode = FbxLayerElement::eByPolygonVertex;
+	else if (name == "polygon") mode = FbxLayerElement::eByPolygon;
+	else if (name == "allSame") mode = FbxLayerElement::eAllSame;
+	else return false;
+	return true;
+}
+
+inline bool ParseReferenceMode(const std::string &name, FbxLayerElement::EReferenceMode &mode)
+{
+	if (name == "direct") mode = FbxLayerElement::eDirect;
+	else if (name == "indexToDirect") mode = FbxLayerElement::eIndexToDirect;
+	else return false;
+	return true;
+}
+
+inline bool ParseHierarchy(const std::string &name, GeneratorOptions::Hierarchy &hierarchy)
+{
+	if (name == "wide") hierarchy = GeneratorOptions::eWide;
+	else if (name == "deep") hierarchy = GeneratorOptions::eDeep;
+	else if (name == "balanced") hierarchy = GeneratorOptions::eBalanced;
+	else return false;
+	return true;
+}
+
+// Builds synthetic scenes for benchmarks and scaling tests. Uses its own
+// SplitMix64 generator because the <random> distributions differ between
+// standard libraries.
+class SceneGenerator
+{
+public:
+	explicit SceneGenerator(const GeneratorOptions &options)
+		: mOptions(options), mState(options.seed) {}
+
+	FbxScene *generate(FbxManager *pManager, const char *name = "generated")
+	{
+		FbxScene *lScene = FbxScene::Create(pManager, name);
+		std::vector<FbxMesh *> lMeshes;
+		for (int i = 0; i < mOptions.meshes; i++)
+			lMeshes.push_back(generateMesh(lScene, ("mesh" + std::to_string(i)).c_str()));
+
+		std::vector<FbxNode *> lNodes;
+		int lNodeCount = mOptions.meshes * std::max(1, mOptions.instances);
+		for (int i = 0; i < lNodeCount; i++)
+		{
+			FbxNode *lNode = FbxNode::Create(lScene, ("node" + std::to_string(i)).c_str());
+			lNode->SetNodeAttribute(lMeshes[i % mOptions.meshes]);
+			FbxNode *lParent = lScene->GetRootNode();
+			if (i > 0 && mOptions.hierarchy == GeneratorOptions::eDeep)
+				lParent = lNodes[i - 1];
+			else if (i > 0 && mOptions.hierarchy == GeneratorOptions::eBalanced)
+				lParent = lNodes[(i - 1) / 2];
+			lParent->AddChild(lNode);
+			lNodes.push_back(lNode);
+		}
+		return lScene;
+	}
+
+	// a mesh owned by `pScene` that is not attached to any node
+	FbxMesh *generateMesh(FbxScene *pScene, const char *name)
+	{
+		FbxMesh *lMesh = FbxMesh::Create(pScene, name);
+		int lVertexCount = std::max(3, mOptions.vertices);
+		lMesh->InitControlPoints(lVertexCount);
+		// points on a logarithmic spiral in the xz plane, lTurn per turn, so
+		// point i + lTurn lies just outside point i and the cells between two
+		// turns are close to square; the outermost turn has radius 1
+		int lTurn = std::max(2, int(std::sqrt(double(lVertexCount))));
+		for (int i = 0; i < lVertexCount; i++)
+		{
+			double lAngle = 2.0 * 3.141592653589793 * i / lTurn;
+			double lRadius = std::exp((lAngle - 2.0 * 3.141592653589793 * (lVertexCount - 1) / lTurn) / lTurn);
+			lMesh->SetControlPointAt(FbxVector4(lRadius * std::cos(lAngle), 0.0, lRadius * std::sin(lAngle), 1.0), i);
+		}
+
+		// Polygons walk the band between two turns: the inner points
+		// lInner..lInner + p, then the outer points lOuter + q..lOuter, so
+		// each one is planar and simple and shares its last edge with the
+		// next. Splitting the size evenly keeps lInner one turn behind lOuter;
+		// sizes stay below two turns so that no point is used twice.
+		int lMin = std::min(std::max(3, mOptions.minPolygonSize), 2 * lTurn - 1);
+		int lMax = std::min(std::max(lMin, mOptions.maxPolygonSize), 2 * lTurn - 1);
+		for (int lInner = 0, lOuter = lTurn;;)
+		{
+			int lSize = lMin + int(next(uint64_t(lMax - lMin + 1)));
+			int p = lInner + lTurn <= lOuter ? (lSize - 1) / 2 : (lSize - 2) / 2;
+			int q = lSize - 2 - p;
+			if (lOuter + q >= lVertexCount)
+				break;
+			lMesh->BeginPolygon();
+			for (int k = 0; k <= p; k++)
+				lMesh->AddPolygon(lInner + k);
+			for (int k = q; k >= 0; k--)
+				lMesh->AddPolygon(lOuter + k);
+			lMesh->EndPolygon();
+			lInner += p;
+			lOuter += q;
+		}
+
+		for (int k = 0; k < mOptions.uvSets; k++)
+		{
+			FbxGeometryElementUV *lUV = lMesh->CreateElementUV(("map" + std::to_string(k + 1)).c_str());
+			fillElement(lMesh, lUV, mOptions.uvMapping, mOptions.uvReference, [this]() {
+				double u = unit();
+				double v = unit();
+				return FbxVector2(u, v);
+			});
+		}
+		for (int k = 0; k < mOptions.colorSets; k++)
+		{
+			FbxGeometryElementVertexColor *lColor = lMesh->CreateElementVertexColor();
+			lColor->SetName(("color" + std::to_string(k + 1)).c_str());
+			fillElement(lMesh, lColor, mOptions.colorMapping, mOptions.colorReference, [this]() {
+				double r = unit();
+				double g = unit();
+				double b = unit();
+				return FbxColor(r, g, b, 1.0);
+			});
+		}
+		if (mOptions.normals)
+		{
+			FbxGeometryElementNormal *lNormal = lMesh->CreateElementNormal();
+			fillElement(lMesh, lNormal, FbxLayerElement::eByPolygonVertex, FbxLayerElement::eDirect, [this]() {
+				double x = unit() - 0.5;
+				double y = unit() - 0.5;
+				double z = unit() - 0.5;
+				return FbxVector4(x, y, z, 0.0);
+			});
+		}
+		return lMesh;
+	}
+
+private:
+	// SplitMix64. Draw values into locals one at a time, the evaluation order
+	// of function arguments is unspecified.
+	uint64_t nextRaw()
+	{
+		uint64_t z = (mState += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+	// [0, n)
+	uint64_t next(uint64_t n) { return nextRaw() % n; }
+	// [0, 1)
+	double unit() { return (nextRaw() >> 11) * (1.0 / 9007199254740992.0); }
+
+	static int expectedCount(FbxMesh *pMesh, FbxLayerElement::EMappingMode mode)
+	{
+		switch (mode)
+		{
+		case FbxLayerElement::eByControlPoint: return pMesh->GetControlPointsCount();
+		case FbxLayerElement::eByPolygonVertex: return pMesh->GetPolygonVertexCount();
+		case FbxLayerElement::eByPolygon: return pMesh->GetPolygonCount();
+		default: return 1;
+		}
+	}
+
+	// Direct elements get one value per mapped item. Indexed elements get
+	// half as many distinct values, referenced in random order.
+	template<class TElement, class TValue>
+	void fillElement(FbxMesh *pMesh, TElement *pElement, FbxLayerElement::EMappingMode mapping,
+		FbxLayerElement::EReferenceMode reference, TValue value)
+	{
+		pElement->SetMappingMode(mapping);
+		pElement->SetReferenceMode(reference);
+		int lCount = expectedCount(pMesh, mapping);
+		if (reference == FbxLayerElement::eDirect)
+		{
+			for (int i = 0; i < lCount; i++)
+				pElement->GetDirectArray().Add(value());
+			return;
+		}
+		int lDistinct = std::max(1, lCount / 2);
+		for (int i = 0; i < lDistinct; i++)
+			pElement->GetDirectArray().Add(value());
+		for (int i = 0; i < lCount; i++)
+			pElement->GetIndexArray().Add(int(next(uint64_t(lDistinct))));
+	}
+
+	GeneratorOptions mOptions;
+	uint64_t mState;
+};
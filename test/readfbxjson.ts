@@ -21,6 +21,10 @@ class FBXMesh {
     get UVChannels(): Array<FBXUVChannel> {
         return this.data.uv.map((element: any) => new FBXUVChannel(element));
     }
+    // welded vertices and indices written by `fbx2json --vertex-buffer`
+    get VertexBuffer(): any {
+        return this.data.vertexBuffer;
+    }
 
     getPoint(index: number) {
         return this.ControlPoints[index];
@@ -31,8 +35,16 @@ class FBXMesh {
     getPointUVs(chIndex: number, ptIndex: number) {
         const uvcList = this.UVChannels;
         const ch = uvcList[chIndex];
-        const polygons = this.Polygons;
         let ret = Array<any>();
+        // `fbx2json --point-adjacency` lists the polygon vertices of each point
+        const adjacency = this.data.pointAdjacency;
+        if (adjacency) {
+            for (let k = adjacency.offsets[ptIndex]; k < adjacency.offsets[ptIndex + 1]; k++) {
+                ret.push(ch.getPointUV(adjacency.polygonVertices[k]));
+            }
+            return ret;
+        }
+        const polygons = this.Polygons;
         let index = 0;
         for (let fi = 0; fi < polygons.length; ++fi) {
             for (let vi = 0; vi < polygons[fi].length; ++vi) {
@@ -48,15 +60,35 @@ class FBXMesh {
 }
 
 class FBXNode {
-    constructor(private data: any) {
+    // meshes: the scene's mesh table when written with --mesh-table
+    constructor(private data: any, private meshes: Array<any> = []) {
     }
 
     getChild(index: number) {
         const d = this.data.children[index];
-        return d && (new FBXNode(d));
+        return d && (new FBXNode(d, this.meshes));
     }
     getMesh() {
-        return this.data.mesh && (new FBXMesh(this.data.mesh));
+        const mesh = typeof this.data.mesh == 'number' ? this.meshes[this.data.mesh] : this.data.mesh;
+        return mesh && (new FBXMesh(mesh));
+    }
+}
+
+// a node of the flat preorder table written by `fbx2json --node-table`
+class FBXTableNode {
+    constructor(private nodes: any, private index: number, private meshes: Array<any>) {
+    }
+
+    getChild(index: number) {
+        let child = this.nodes.firstChild[this.index];
+        for (let i = 0; i < index && child >= 0; i++) {
+            child = this.nodes.nextSibling[child];
+        }
+        return child >= 0 ? new FBXTableNode(this.nodes, child, this.meshes) : undefined;
+    }
+    getMesh() {
+        const mesh = this.meshes[this.nodes.mesh[this.index]];
+        return mesh && (new FBXMesh(mesh));
     }
 }
 
@@ -64,16 +96,148 @@ class FBXContent {
     constructor(private data: any) {
     }
     getRoot() {
-        return new FBXNode(this.data.RootNode);
+        if (this.data.nodes) {
+            return new FBXTableNode(this.data.nodes, 0, this.data.meshes);
+        }
+        return new FBXNode(this.data.RootNode, this.data.meshes);
     }
 }
 
 
 import * as fs from 'fs'
+import * as path from 'path'
+
+// references written by `fbx2json --binary-buffers`
+interface BufferRef {
+    buffer: string;
+    byteOffset: number;
+    count: number;
+    componentType: 'int32' | 'float64';
+    components: number;
+}
+
+function isBufferRef(value: any): value is BufferRef {
+    return value !== null && typeof value === 'object' && typeof value.buffer === 'string' && typeof value.byteOffset === 'number';
+}
+
+type BufferCache = { [name: string]: Buffer };
 
-const rawData = fs.readFileSync(`${__dirname}/../test/mayaexport.json`, 'utf8');
+function mapBuffer(ref: BufferRef, buffers: BufferCache, dir: string) {
+    let buf = buffers[ref.buffer];
+    if (!buf) {
+        buf = fs.readFileSync(path.join(dir, ref.buffer));
+        buffers[ref.buffer] = buf;
+    }
+    const elementSize = ref.componentType == 'float64' ? 8 : 4;
+    const length = ref.count * ref.components;
+    let arrayBuffer = buf.buffer;
+    let offset = buf.byteOffset + ref.byteOffset;
+    if (offset % elementSize != 0) {
+        // small files may live unaligned inside node's buffer pool
+        arrayBuffer = buf.buffer.slice(offset, offset + length * elementSize);
+        offset = 0;
+    }
+    if (ref.componentType == 'float64') {
+        return new Float64Array(arrayBuffer, offset, length);
+    }
+    return new Int32Array(arrayBuffer, offset, length);
+}
+
+// replace buffer references with the nested arrays of the plain JSON layout
+function resolveBuffers(value: any, dir: string, buffers: BufferCache = {}): any {
+    if (Array.isArray(value)) {
+        return value.map((v: any) => resolveBuffers(v, dir, buffers));
+    }
+    if (value === null || typeof value !== 'object') {
+        return value;
+    }
+    const ret: any = {};
+    for (const key of Object.keys(value)) {
+        const v = value[key];
+        if (!isBufferRef(v)) {
+            ret[key] = resolveBuffers(v, dir, buffers);
+            continue;
+        }
+        const data = mapBuffer(v, buffers, dir);
+        if (key == 'polygons') {
+            // FBX PolygonVertexIndex: last vertex of a polygon is stored as ~index
+            const polygons = Array<Array<number>>();
+            let poly = Array<number>();
+            for (let k = 0; k < data.length; k++) {
+                const i = data[k];
+                if (i < 0) {
+                    poly.push(~i);
+                    polygons.push(poly);
+                    poly = [];
+                } else {
+                    poly.push(i);
+                }
+            }
+            ret[key] = polygons;
+        } else if (v.components == 1) {
+            ret[key] = Array.from(data);
+        } else {
+            const tuples = Array<Array<number>>();
+            for (let i = 0; i < v.count; i++) {
+                tuples.push(Array.from(data.subarray(i * v.components, (i + 1) * v.components)));
+            }
+            ret[key] = tuples;
+        }
+    }
+    return ret;
+}
+
+// replace {"sharedArray": index} references written by `fbx2json --dedup-arrays`
+// with their entry of the sharedArrays table
+function resolveSharedArrays(value: any, table: Array<any>): any {
+    if (Array.isArray(value)) {
+        return value.map((v: any) => resolveSharedArrays(v, table));
+    }
+    if (value === null || typeof value !== 'object') {
+        return value;
+    }
+    if (typeof value.sharedArray === 'number' && Object.keys(value).length == 1) {
+        return table[value.sharedArray];
+    }
+    const ret: any = {};
+    for (const key of Object.keys(value)) {
+        ret[key] = resolveSharedArrays(value[key], table);
+    }
+    return ret;
+}
+
+// byte ranges written by `fbx2json --toc` into <output>.toc.json
+interface TocRange {
+    offset: number;
+    length: number;
+}
+
+// parses only `range` of the JSON file instead of the whole document
+function readTocRange(jsonPath: string, range: TocRange): any {
+    const fd = fs.openSync(jsonPath, 'r');
+    try {
+        const buf = Buffer.alloc(range.length);
+        fs.readSync(fd, buf, 0, range.length, range.offset);
+        return JSON.parse(buf.toString('utf8'));
+    } finally {
+        fs.closeSync(fd);
+    }
+}
+
+const jsonPath = `${__dirname}/../test/mayaexport.json`;
+const tocPath = jsonPath.replace(/\.json$/, '.toc.json');
+if (fs.existsSync(tocPath)) {
+    const toc = JSON.parse(fs.readFileSync(tocPath, 'utf8'));
+    if (toc.meshes.length > 0) {
+        const uvs = toc.meshes[0].arrays.find((a: any) => a.path == 'uv/0/directArray');
+        console.log(toc.meshes[0].name, uvs ? readTocRange(jsonPath, uvs) : null);
+    }
+}
+const rawData = fs.readFileSync(jsonPath, 'utf8');
+const rawContent = JSON.parse(rawData!);
+const sharedContent = resolveSharedArrays(rawContent, rawContent.sharedArrays || []);
 
-const fbxContent = new FBXContent(JSON.parse(rawData!));
+const fbxContent = new FBXContent(resolveBuffers(sharedContent, path.dirname(jsonPath)));
 console.log(fbxContent);
 
 const root = fbxContent.getRoot();